@@ -25,6 +25,26 @@ link_directories(
 
 message("${DEPENDENCY_PATH}/lib")
 
+# 样本与二进制消息编解码，不依赖Qt与OPC，供消费方单独使用
+add_library(OPCCodec STATIC
+        include/Sample.h
+        src/Sample.cpp
+        include/BinaryCodec.h
+        src/BinaryCodec.cpp
+)
+
+target_link_libraries(OPCCodec
+        spdlog::spdlog
+        )
+
+add_executable(OPCDump
+        tools/OPCDump.cpp
+)
+
+target_link_libraries(OPCDump
+        OPCCodec
+        )
+
 add_executable(OPCClient
         src/main.cpp
         include/Machine.h
@@ -38,9 +58,24 @@ add_executable(OPCClient
         include/Exception.h
         src/Exception.cpp
         include/GlobalDefine.h
+        include/ScanScheduler.h
+        src/ScanScheduler.cpp
+        include/IOEngine.h
+        src/IOEngine.cpp
+        include/ReportFilter.h
+        src/ReportFilter.cpp
+        include/BrowseIndex.h
+        src/BrowseIndex.cpp
+        include/Spool.h
+        src/Spool.cpp
+        include/SampleRing.h
+        src/SampleRing.cpp
+        include/History.h
+        src/History.cpp
 )
 
 target_link_libraries(OPCClient
+        OPCCodec
         Qt6::Core
         spdlog::spdlog
         yaml-cpp::yaml-cpp
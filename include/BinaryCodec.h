@@ -0,0 +1,52 @@
+//
+// Created by cumtzt on 25-4-10.
+//
+
+#ifndef BINARYCODEC_H
+#define BINARYCODEC_H
+
+#include "Sample.h"
+#include <string>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+// 二进制消息格式，所有整数为小端序。一条Kafka消息包含一条或多条记录：
+//   记录头  "OPCB"(4) | 版本(u8) | 标志(u8，保留) | 记录体长度(u32)
+//   记录体  字典ID(u32) | 字典大小(u32) | 采集时间(i64，Unix微秒) | 样本数(varint) | 样本...
+//   样本    字典下标(varint) | 标记(u8) | 值 | [状态码(u32)] | [源时间戳相对采集时间的差(zigzag varint)]
+// 标记低4位为SampleValue的类型序号，bit7表示带状态码，bit6表示带源时间戳；
+// 数值按原生宽度写入，字符串为长度(varint)加内容。
+// 节点Code通过字典下标引用，字典以JSON发布到单独的字典topic，消息键为字典ID。
+inline constexpr uint8_t BinarySchemaVersion = 1;
+
+struct BinaryRecord {
+    uint32_t dictionaryId = 0;
+    // 编码时字典的大小，解码方需要不小于该大小的字典
+    uint32_t dictionarySize = 0;
+    int64_t collectTime = 0;
+    std::vector<Sample> samples;
+};
+
+struct BinaryDictionary {
+    uint32_t id = 0;
+    // "电站code:设备code"
+    std::string source;
+    NodeDictionary nodes;
+};
+
+// 由数据来源计算字典ID(FNV-1a)
+uint32_t binaryDictionaryId(const std::string& source);
+
+// 编码一条记录并追加到out
+void encodeBinaryRecord(uint32_t dictionaryId, uint32_t dictionarySize, int64_t collectTime,
+                        std::span<const Sample> samples, std::string& out);
+
+// 解码消息中的全部记录，失败时error说明原因
+bool decodeBinaryRecords(const char* data, size_t size, std::vector<BinaryRecord>& records, std::string& error);
+
+std::string encodeBinaryDictionary(uint32_t id, const std::string& source, const NodeDictionary& nodes);
+
+bool decodeBinaryDictionary(const std::string& json, BinaryDictionary& dictionary);
+
+#endif //BINARYCODEC_H
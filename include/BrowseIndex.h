@@ -0,0 +1,130 @@
+//
+// Created by cumtzt on 25-3-28.
+//
+
+#ifndef BROWSEINDEX_H
+#define BROWSEINDEX_H
+
+#include <open62541pp/open62541pp.hpp>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+#include <cstdint>
+
+struct BrowseEntry {
+    // 数值型NodeId为"ns:id"格式，与采集节点Code一致，其余为NodeId字符串
+    std::string code;
+    // 自Objects文件夹起的浏览路径，如"/Server/ServerStatus"
+    std::string path;
+    uint32_t nodeClass = 0;
+    // 变量节点的数据类型名称
+    std::string dataType;
+};
+
+// 地址空间浏览索引：整体替换、读取无锁，可持久化到磁盘以便重启后立即提供查询
+class BrowseIndex {
+public:
+    BrowseIndex() = default;
+
+    // 等待未完成的缓存写入
+    ~BrowseIndex();
+
+    BrowseIndex(BrowseIndex const&) = delete;
+
+    BrowseIndex& operator=(BrowseIndex const&) = delete;
+
+    void setCacheFile(const std::string& file);
+
+    // 从磁盘加载索引，返回是否成功
+    bool load();
+
+    bool save() const;
+
+    // 在独立线程写入缓存，不阻塞调用方；写入期间再次请求时，结束前再保存一次最新索引
+    void saveAsync();
+
+    void replace(std::vector<BrowseEntry> entries, int64_t updateTime);
+
+    [[nodiscard]] std::shared_ptr<const std::vector<BrowseEntry>> entries() const;
+
+    // 索引最后一次刷新的Unix时间(秒)，0表示从未刷新
+    [[nodiscard]] int64_t updateTime() const;
+
+private:
+    std::string mCacheFile;
+
+    std::atomic<std::shared_ptr<const std::vector<BrowseEntry>>> mpEntries;
+
+    std::atomic<int64_t> mUpdateTime = 0;
+
+    mutable std::mutex mFileLocker;
+
+    // 保护写入线程状态
+    std::mutex mSaveLocker;
+
+    std::thread mSaveThread;
+
+    bool mSaving = false;
+
+    bool mSaveRequested = false;
+};
+
+// 异步广度优先遍历地址空间，由持有客户端锁的线程反复调用step推进；
+// 每轮均从Objects文件夹完整遍历，不做增量比对，请求发送失败时放弃本轮(running()返回false)
+class BrowseCrawler {
+public:
+    explicit BrowseCrawler(size_t maxNodes = 100000, size_t batchSize = 50, size_t maxInFlight = 4);
+
+    void start(opcua::Client& client);
+
+    // 发起后续请求，遍历与数据类型读取全部完成后返回true
+    bool step(opcua::Client& client);
+
+    [[nodiscard]] bool running() const;
+
+    void cancel();
+
+    std::vector<BrowseEntry> takeEntries();
+
+private:
+    void browse(opcua::Client& client);
+
+    void readDataTypes(opcua::Client& client);
+
+    void abort(const std::exception& e);
+
+    void onBrowseResult(opcua::Client& client, const opcua::BrowseResult& result, const std::string& path);
+
+    static std::string nodeCode(const opcua::NodeId& id);
+
+    size_t mMaxNodes;
+
+    size_t mBatchSize;
+
+    size_t mMaxInFlight;
+
+    // 本轮遍历的代次，取消或重新开始后旧回调直接丢弃
+    std::shared_ptr<uint64_t> mpGeneration = std::make_shared<uint64_t>(0);
+
+    bool mRunning = false;
+
+    size_t mInFlight = 0;
+
+    std::deque<std::pair<opcua::NodeId, std::string>> mPending;
+
+    std::unordered_set<std::string> mVisited;
+
+    std::vector<BrowseEntry> mEntries;
+
+    // 待读取数据类型的变量节点：(mEntries下标, NodeId)
+    std::vector<std::pair<size_t, opcua::NodeId>> mVariables;
+
+    size_t mNextVariable = 0;
+};
+
+#endif //BROWSEINDEX_H
@@ -0,0 +1,106 @@
+//
+// Created by cumtzt on 25-4-14.
+//
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "Sample.h"
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+
+struct HistoryPoint {
+    // Unix纪元毫秒
+    int64_t time = 0;
+    double value = 0;
+};
+
+// 按Gorilla方式压缩的数据块：时间戳为毫秒的二阶差分，数值为与前值的异或；
+// 块按固定大小预分配，写满后封存，新数据写入新块
+class HistoryBlock {
+public:
+    HistoryBlock();
+
+    // 块已满时返回false，调用方封存后写入新块
+    bool append(int64_t time, double value);
+
+    void decode(int64_t from, int64_t to, std::vector<HistoryPoint>& points) const;
+
+    [[nodiscard]] int64_t startTime() const;
+
+    [[nodiscard]] int64_t endTime() const;
+
+    [[nodiscard]] uint32_t count() const;
+
+    [[nodiscard]] size_t bytes() const;
+
+private:
+    void write(uint64_t value, int bits);
+
+    std::vector<uint64_t> mWords;
+
+    size_t mBitSize = 0;
+
+    uint32_t mCount = 0;
+
+    int64_t mStartTime = 0;
+
+    int64_t mLastTime = 0;
+
+    int64_t mLastDelta = 0;
+
+    uint64_t mLastValue = 0;
+
+    // 上一个异或值有效位的前导零与尾随零个数
+    int mLeading = -1;
+
+    int mTrailing = 0;
+};
+
+// 单个设备全部节点的历史数据，内存超过上限时淘汰最早封存的块
+class History {
+public:
+    // budget为内存上限(字节)
+    explicit History(size_t budget);
+
+    History(History const&) = delete;
+
+    History& operator=(History const&) = delete;
+
+    // 非数值样本不记录；时间早于或等于该节点上一点的样本忽略
+    void append(const std::vector<Sample>& samples);
+
+    void query(uint32_t index, int64_t from, int64_t to, std::vector<HistoryPoint>& points);
+
+    size_t memoryBytes();
+
+    uint64_t pointCount();
+
+private:
+    struct NodeHistory {
+        std::deque<std::unique_ptr<HistoryBlock>> blocks;
+        int64_t lastTime = INT64_MIN;
+    };
+
+    // 持有mLocker时调用
+    void evict();
+
+    std::mutex mLocker;
+
+    size_t mBudget;
+
+    size_t mBytes = 0;
+
+    uint64_t mPoints = 0;
+
+    // 按节点字典下标存放，扩容时不移动已有节点
+    std::deque<NodeHistory> mNodes;
+
+    // 封存顺序即块的新旧顺序，记录节点下标用于淘汰
+    std::deque<uint32_t> mSealed;
+};
+
+#endif //HISTORY_H
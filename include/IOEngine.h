@@ -0,0 +1,62 @@
+//
+// Created by cumtzt on 25-3-20.
+//
+
+#ifndef IOENGINE_H
+#define IOENGINE_H
+
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+class Machine;
+
+// 共享I/O引擎：少量工作线程以异步客户端API驱动全部OPC会话，
+// 线程数与机器数量无关，每个Machine固定由一个工作线程驱动
+class IOEngine {
+public:
+    explicit IOEngine(int threads = 2, std::chrono::milliseconds tick = std::chrono::milliseconds(5));
+
+    IOEngine(IOEngine const&) = delete;
+
+    IOEngine& operator=(IOEngine const&) = delete;
+
+    ~IOEngine();
+
+    void attach(const std::shared_ptr<Machine>& machine);
+
+    void detach(const std::shared_ptr<Machine>& machine);
+
+    // 唤醒驱动该Machine的工作线程，使其立即处理新提交的请求
+    void wake(const Machine* machine);
+
+    void start();
+
+    void stop();
+
+    [[nodiscard]] int threads() const;
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::mutex locker;
+        std::condition_variable condition;
+        std::vector<std::shared_ptr<Machine>> machines;
+        bool woken = false;
+    };
+
+    void run(Worker& worker);
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+
+    // 有请求在途时的最长轮询间隔
+    std::chrono::milliseconds mTick;
+
+    std::atomic<bool> mRunning = false;
+};
+
+#endif //IOENGINE_H
@@ -6,26 +6,318 @@
 #define KAFKAPRODUCER_H
 
 #include <QObject>
+#include <QTimer>
 #include <cppkafka/producer.h>
 #include "GlobalDefine.h"
+#include "Sample.h"
+#include "Spool.h"
+#include "BinaryCodec.h"
+#include "SampleRing.h"
+#include <unordered_map>
+#include <map>
+#include <vector>
+#include <memory>
+#include <span>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+// 消息格式：JSON数组或按字典编码的二进制记录
+enum class MessageFormat {
+    Json,
+    Binary
+};
+
+// 消息键：决定分区，同一键的消息进入同一分区并保持顺序
+enum class MessageKey {
+    None,
+    // "电站code:设备code"
+    Machine,
+    // "电站code:设备code:节点code"，每个节点单独成为一条消息
+    Node
+};
+
+// JSON中时间的格式
+enum class TimeFormat {
+    // 本地时间"yyyy-MM-dd hh:mm:ss.zzz"
+    Legacy,
+    // UTC时间"yyyy-MM-ddThh:mm:ss.zzzzzzZ"
+    Iso,
+    // Unix纪元毫秒与微秒，输出为数字
+    EpochMs,
+    EpochUs
+};
+
+struct TopicConfig {
+    MessageFormat format = MessageFormat::Json;
+    // 二进制格式的字典topic，默认为"<topic>_dictionary"
+    std::string dictionaryTopic;
+};
+
+// 发送缓冲：交给librdkafka时不复制内容，投递报告返回后归还缓冲池
+struct KafkaBuffer {
+    std::string topic;
+    std::string key;
+    bool dictionary = false;
+    std::string payload;
+    // 投递失败后已重试的次数
+    uint32_t attempts = 0;
+    // 从落盘队列重发的记录序号，0表示不是重发记录
+    uint64_t spoolId = 0;
+};
+
+// 发送缓冲池，归还的缓冲保留容量，稳定运行后序列化与发送不再分配内存
+class BufferPool {
+public:
+    std::unique_ptr<KafkaBuffer> acquire();
+
+    void release(std::unique_ptr<KafkaBuffer> buffer);
+
+    // 池中无空闲缓冲时新分配的次数
+    uint64_t allocations();
+
+private:
+    // 池中缓冲的容量上限，超出的缓冲直接释放
+    static constexpr size_t MaxPooledBytes = 64 * 1024 * 1024;
+
+    std::mutex mLocker;
+
+    std::vector<std::unique_ptr<KafkaBuffer>> mFree;
+
+    size_t mPooledBytes = 0;
+
+    uint64_t mAllocations = 0;
+};
+
+// 按设备预先生成的消息前缀，避免每个采集周期重复拼接
+struct SourcePrefix {
+    // "电站code:设备code"
+    std::string source;
+    uint32_t dictionaryId = 0;
+    // JSON对象开头，到collectTime的值之前为止
+    std::string json;
+    // 按节点键，下标与节点字典一致
+    std::vector<std::string> nodeKeys;
+};
+
+// 聚合中的消息：同一topic的多个采集周期拼接为一个JSON数组，二进制格式直接顺序拼接记录
+struct AggregateMessage {
+    std::unique_ptr<KafkaBuffer> buffer;
+    size_t cycles = 0;
+    bool json = true;
+    std::chrono::steady_clock::time_point firstTime;
+};
+
+// 已发布的字典，大小变化或超过重发周期时重新发布
+struct PublishedDictionary {
+    size_t size = 0;
+    std::chrono::steady_clock::time_point time;
+};
+
+// 按topic统计的发送结果
+struct TopicStatistics {
+    // 已交给librdkafka的消息数
+    uint64_t produced = 0;
+    uint64_t delivered = 0;
+    uint64_t retried = 0;
+    uint64_t dropped = 0;
+    // 写入落盘队列等待代理恢复后重发
+    uint64_t spooled = 0;
+};
+
 class KafkaProducer : public QObject {
     Q_OBJECT
 
 public:
     explicit KafkaProducer(QObject *parent = nullptr);
 
+    ~KafkaProducer() override;
+
+    // 多个生产者分片时各自使用落盘队列目录下的子目录，须在loadConfig之前调用
+    void setShard(int index, int count);
+
+    // 修改的配置由生产线程读取，须在采集开始前调用且只调用一次
     void loadConfig(const std::string& configFile);
 
+    // 创建采集端写入的环形队列，须在采集开始前调用
+    void createSampleRing(size_t capacity, OverflowPolicy policy);
+
+    std::shared_ptr<SampleRing> sampleRing();
+
+    std::map<std::string, TopicStatistics> statistics();
+
+    // 进程内暂存队列的消息数与字节数
+    std::pair<size_t, size_t> queueUsage();
+
+    // 落盘队列占用的磁盘字节数与淘汰的段数
+    std::pair<size_t, uint64_t> spoolUsage();
+
+    uint64_t bufferAllocations();
+
+signals:
+
+    // 发送积压开始或解除，Machine据此合并上报
+    void backpressureChanged(bool active);
+
 public slots:
 
-    void onNewDatas(const std::string& topic, const std::string& code, const std::vector<std::pair<std::string,std::string>>& datas);
+    // 发送聚合时间超过max_delay的消息并重试暂存队列
+    void onFlushTimeout();
 
 private:
 
+    // 取出环形队列中的批次，单次最多取出一个容量
+    void drainRing();
+
+    void onNewDatas(const std::string& topic, const std::string& code, const SampleBatch& batch);
+
+    SourcePrefix& sourcePrefix(const std::string& source);
+
+    // 单个采集周期追加到out：JSON对象（不含外层数组）或二进制记录
+    void encode(const SourcePrefix& prefix, const NodeDictionary& dictionary, std::span<const Sample> samples,
+                int64_t collectTime, bool json, std::string& out);
+
+    void serialize(const SourcePrefix& prefix, const NodeDictionary& dictionary, std::span<const Sample> samples,
+                   int64_t collectTime, std::string& out);
+
+    // 按mTimeFormat写入Unix纪元微秒时间；文本格式中日期到分钟的部分每分钟格式化一次，其余直接写数字
+    void appendTime(std::string& out, int64_t microseconds);
+
+    // 按键发送或加入聚合
+    void publish(const std::string& topic, const std::string& key, const SourcePrefix& prefix,
+                 const NodeDictionary& dictionary, std::span<const Sample> samples, int64_t collectTime, bool json);
+
+    void append(const std::string& topic, const std::string& key, const SourcePrefix& prefix,
+                const NodeDictionary& dictionary, std::span<const Sample> samples, int64_t collectTime, bool json);
+
+    const TopicConfig& topicConfig(const std::string& topic);
+
+    void publishDictionary(const std::string& topic, uint32_t id, const std::string& source,
+                           const NodeDictionary& dictionary);
+
+    void flush(AggregateMessage& message);
+
+    void produce(std::unique_ptr<KafkaBuffer> buffer);
+
+    // 交给librdkafka，成功后缓冲由投递报告取回；队列已满时返回false并保留缓冲，其余错误计为丢弃
+    bool tryProduce(std::unique_ptr<KafkaBuffer>& buffer);
+
+    void enqueue(std::unique_ptr<KafkaBuffer> buffer);
+
+    void drain();
+
+    // 代理可用时按drain_rate限速重发落盘队列
+    void drainSpool();
+
+    // 持有mQueueLocker时调用，记录重发结果；连续投递成功的记录依次从落盘队列确认，
+    // 有失败时待在途记录全部返回后退回到第一条未确认记录重新发送
+    void settleSpool(uint64_t id, bool delivered);
+
+    // 持有mQueueLocker时调用，未开启落盘或写入失败时计为丢弃
+    void spool(const KafkaBuffer& buffer);
+
+    // 持有mQueueLocker时调用，丢弃字典消息后所有字典重新发布
+    void drop(const KafkaBuffer& buffer);
+
+    void onDelivery(const cppkafka::Message& message);
+
+    void updateBackpressure();
+
     std::shared_ptr<cppkafka::Producer> mpProducer = nullptr;
 
+    std::shared_ptr<SampleRing> mpSampleRing = nullptr;
+
+    // 出队的批次，字符串与vector在多次出队间复用
+    BatchSlot mRingSlot;
+
     std::string mStationCode;
 
+    MessageKey mMessageKey = MessageKey::None;
+
+    TimeFormat mTimeFormat = TimeFormat::Legacy;
+
+    int mShardIndex = 0;
+
+    int mShardCount = 1;
+
+    // 聚合模式：多个采集周期合并为一条消息，直到达到大小上限或等待超时
+    bool mAggregation = false;
+
+    size_t mAggregateMaxBytes = 900 * 1024;
+
+    std::chrono::milliseconds mAggregateMaxDelay{1000};
+
+    // topic -> 消息键 -> 聚合中的消息，不同键分别聚合
+    std::unordered_map<std::string, std::unordered_map<std::string, AggregateMessage>> mAggregates;
+
+    QTimer* mpFlushTimer = nullptr;
+
+    std::unordered_map<std::string, TopicConfig> mTopicConfigs;
+
+    // topic -> 字典ID -> 发布记录
+    std::unordered_map<std::string, std::unordered_map<uint32_t, PublishedDictionary>> mDictionaries;
+
+    std::atomic<bool> mDictionaryLost = false;
+
+    std::unordered_map<std::string, SourcePrefix> mSourcePrefixes;
+
+    int64_t mCachedMinute = -1;
+
+    std::string mCachedDate;
+
+    // 字典重发周期，保证新加入的消费者能够拿到字典
+    std::chrono::seconds mDictionaryInterval{600};
+
+    // 后台线程轮询投递报告
+    std::thread mPollThread;
+
+    std::atomic<bool> mPolling = false;
+
+    // 保护暂存队列与统计，投递报告在轮询线程中回调
+    std::mutex mQueueLocker;
+
+    // 因librdkafka队列已满或等待重投而暂存在进程内的消息
+    std::deque<std::unique_ptr<KafkaBuffer>> mPendingMessages;
+
+    size_t mPendingBytes = 0;
+
+    size_t mQueueMaxBytes = 64 * 1024 * 1024;
+
+    uint32_t mMaxRetries = 3;
+
+    std::map<std::string, TopicStatistics> mStatistics;
+
+    bool mBackpressure = false;
+
+    Spool mSpool;
+
+    bool mSpoolEnabled = false;
+
+    // 落盘队列每秒重发的消息数
+    int mDrainRate = 200;
+
+    double mDrainBudget = 0;
+
+    enum class DrainState {
+        Pending,
+        Delivered,
+        Failed
+    };
+
+    // 已发出的重发记录按读取顺序的投递状态，mDrainBase为队首记录序号
+    std::deque<DrainState> mDrainWindow;
+
+    uint64_t mDrainBase = 0;
+
+    std::chrono::steady_clock::time_point mLastDrain;
+
+    // 代理全部不可用时新消息直接落盘，只保留一条在途消息用于探测恢复
+    std::atomic<bool> mBrokerDown = false;
+
+    BufferPool mBufferPool;
+
 };
 
 #endif //KAFKAPRODUCER_H
@@ -8,19 +8,173 @@
 #include <open62541pp/open62541pp.hpp>
 #include "GlobalDefine.h"
 #include <yaml-cpp/node/convert.h>
-#include <QTimer>
-#include <QThread>
+#include <QObject>
 #include "Exception.h"
+#include "ScanScheduler.h"
+#include "ReportFilter.h"
+#include "Sample.h"
+#include "BrowseIndex.h"
+#include "SampleRing.h"
+#include "History.h"
+#include <unordered_map>
+#include <map>
+#include <optional>
+#include <functional>
+#include <deque>
+#include <future>
+#include <random>
+#include <shared_mutex>
+#include <span>
 
 DECLARE_EXCEPTION(OPCServerNotConnectException,RuntimeException)
 DECLARE_EXCEPTION(OPCNodeCodeFormatErrorException, RuntimeException)
 DECLARE_EXCEPTION(OPCNodeNotExistException,RuntimeException)
 DECLARE_EXCEPTION(OPCNodeTypeNotSupportException,RuntimeException)
+DECLARE_EXCEPTION(OPCCommandTimeoutException,RuntimeException)
+DECLARE_EXCEPTION(OPCWriteFailedException,RuntimeException)
+DECLARE_EXCEPTION(OPCReadFailedException,RuntimeException)
+DECLARE_EXCEPTION(OPCHistoryDisabledException,RuntimeException)
+
+// 节点句柄缓存：节点Code只解析一次，浏览名与数据类型在会话内只读取一次
+struct NodeHandle {
+    opcua::NodeId id;
+    std::string browseName;
+    // 数据类型，UA_DATATYPEKINDS表示尚未获知
+    uint32_t typeKind = UA_DATATYPEKINDS;
+    // 最近一次读写返回的状态码
+    opcua::StatusCode status;
+    // 节点Code格式是否合法
+    bool valid = true;
+    // 当前会话内是否已解析浏览名与数据类型
+    bool resolved = false;
+
+    [[nodiscard]] bool exists() const
+    {
+        return valid && status.get() != UA_STATUSCODE_BADNODEIDUNKNOWN;
+    }
+};
+
+// 单个节点的当前值与时间戳
+struct NodeValue {
+    std::string name;
+    std::string type;
+    std::string value;
+    // UA_StatusCode
+    uint32_t status = 0;
+    // Unix纪元微秒，0表示服务器未提供
+    int64_t sourceTime = 0;
+    int64_t serverTime = 0;
+    // 读取返回时的本机时间
+    int64_t acquireTime = 0;
+};
+
+// 最新值缓存中的一项，读取失败时只更新状态码
+struct LastValue {
+    Sample sample;
+    std::string name;
+    bool valid = false;
+};
+
+// 扫描组：组内节点按组自身的周期采集
+struct ScanGroup {
+    std::string name;
+    // 采集周期，0表示跟随Machine的采集间隔
+    std::chrono::milliseconds interval{0};
+    std::set<std::string> nodes;
+    // 调度器为运行期状态，在各版本节点集合间共享，仅在持有mClientLocker时推进
+    std::shared_ptr<ScanScheduler> scheduler;
+};
+
+// 采集节点集合的不可变快照，修改时复制后整体替换，读取方无需加锁
+struct NodeSet {
+    uint64_t version = 0;
+    std::map<std::string, ScanGroup> groups;
+    // 全部采集节点，为各扫描组节点的并集
+    std::set<std::string> nodes;
+    // 节点字典只追加，已移除节点的下标不复用
+    std::shared_ptr<const NodeDictionary> dictionary;
+    std::unordered_map<std::string, uint32_t> indices;
+};
+
+// 未指定扫描组的节点归入默认组，周期即Machine的采集间隔
+inline const std::string DefaultScanGroup = "default";
+
+// 批量写入中单个节点的结果
+struct WriteResult {
+    // UA_StatusCode
+    uint32_t status = UA_STATUSCODE_GOOD;
+    std::string message;
+};
+
+// 写入指令：由HTTP线程提交，工作线程在发起下一批读取前优先发送
+struct WriteCommand {
+    std::vector<std::pair<std::string, std::string>> writes;
+    std::vector<WriteResult> results;
+    std::promise<std::vector<WriteResult>> promise;
+    std::chrono::steady_clock::time_point enqueueTime;
+    // 超过期限仍未发送的指令直接以超时结束
+    std::chrono::steady_clock::time_point deadline;
+    // 本指令使用的节点句柄，采集节点从缓存复制，其余节点只在指令内解析，不进入缓存
+    std::unordered_map<std::string, NodeHandle> handles;
+    bool completed = false;
+};
+
+// 指令从提交到收到写入响应的延迟统计，单位us
+struct CommandStatistics {
+    uint64_t commands = 0;
+    // 至少一个节点写入失败的指令数
+    uint64_t failures = 0;
+    // 调用方等待超时的指令数
+    uint64_t timeouts = 0;
+    int64_t lastLatency = 0;
+    int64_t maxLatency = 0;
+    double meanLatency = 0;
+};
+
+// 连接状态，可在不持有mClientLocker时读取
+enum class ConnectionState {
+    // 未连接，等待下一次重连
+    Disconnected,
+    Connecting,
+    // 安全通道断开后保留会话重新连接，成功时订阅与节点缓存继续使用
+    Reactivating,
+    Connected
+};
+
+const char* connectionStateName(ConnectionState state);
 
-class Machine : public QThread {
+// 采集模式：轮询读取或订阅监控项
+enum class AcquisitionMode {
+    Poll,
+    Subscription
+};
+
+// 一次轮询中批量读取的上下文，按Read请求大小切分后逐批发送，
+// 批次之间让出给等待中的写入指令
+struct ReadCycle {
+    struct Entry {
+        std::string code;
+        uint32_t index = 0;
+        NodeHandle* handle = nullptr;
+        // 该节点尚未解析，需要同时读取BrowseName
+        bool resolving = false;
+    };
+    std::vector<Entry> entries;
+    std::vector<std::shared_ptr<ScanScheduler>> schedulers;
+    std::vector<Sample> samples;
+    size_t batchSize = 0;
+    // 下一批的起始下标
+    size_t next = 0;
+    bool inFlight = false;
+};
+
+// 单个OPC服务的会话，由IOEngine的工作线程调用process驱动
+class Machine : public QObject {
     Q_OBJECT
 
 public:
+    using Clock = ScanScheduler::Clock;
+
     explicit Machine(QObject *parent = nullptr);
 
     ~Machine() override;
@@ -33,14 +187,23 @@ public:
 
     [[nodiscard]] std::string url() const;
 
-    void collectNode(const std::string &node);
+    void addScanGroup(const std::string& name, int interval);
+
+    void collectNode(const std::string &node, const std::string& group = DefaultScanGroup);
 
     void removeCollectingNode(const std::string &node);
 
     std::set<std::string> collectingNodes();
 
+    std::shared_ptr<const NodeSet> nodeSet() const;
+
     std::set<std::string> allNodes();
 
+    std::shared_ptr<const std::vector<BrowseEntry>> browseEntries();
+
+    // 设置浏览索引的缓存文件与刷新周期(s)，并从缓存加载已有索引
+    void setBrowseCache(const std::string& file, int refreshInterval);
+
     void setTopic(const std::string& topic);
 
     std::string topic();
@@ -49,27 +212,162 @@ public:
 
     int interval();
 
+    void setReadBatchSize(int size);
+
+    int readBatchSize();
+
+    void setMode(AcquisitionMode mode);
+
+    AcquisitionMode mode();
+
+    void setSubscriptionParameters(double publishingInterval, double samplingInterval, uint32_t queueSize);
+
+    void setAlignToWallClock(bool align);
+
+    // 下游发送积压时按interval(ms)合并上报，每个节点只保留最新样本
+    void setBackpressureInterval(int interval);
+
+    void setBackpressure(bool active);
+
+    // 重连退避的初始与最大间隔(ms)
+    void setReconnectBackoff(int minimum, int maximum);
+
+    ConnectionState connectionState() const;
+
+    // 自上次连接成功以来连续失败的重连次数
+    uint32_t reconnectAttempts() const;
+
+    void setReportByException(bool enabled, int heartbeat);
+
+    void setDeadband(const std::string& nodeCode, const Deadband& deadband);
+
+    std::map<std::string, std::pair<int, ScanStatistics>> scanStatistics();
+
+    // 写入指令的最长等待时间(ms)
+    void setCommandTimeout(int timeout);
+
+    CommandStatistics commandStatistics();
+
+    // 提交指令后用于唤醒驱动该Machine的工作线程
+    void setWakeup(std::function<void()> wakeup);
+
+    // 采集批次写入发送端的环形队列，须在start之前设置
+    void setSampleRing(std::shared_ptr<SampleRing> ring);
+
+    // 启用节点历史记录，bytes为该设备历史数据的内存上限，须在start之前设置
+    void setHistoryBudget(size_t bytes);
+
     void start();
 
     void stop();
 
     void setNodeValue(const std::string& nodeCode,const std::string& value);
 
-    void getNode(const std::string &nodeCode,std::string& name,std::string& type,std::string& value);
+    // 一次Write请求写入多个节点，返回与writes一一对应的结果
+    std::vector<WriteResult> setNodeValues(const std::vector<std::pair<std::string,std::string>>& writes);
+
+    void getNode(const std::string &nodeCode, NodeValue& node);
+
+    // 从最新值缓存读取，不访问设备；节点未采集或尚无数据时返回false
+    bool lastValue(const std::string& nodeCode, NodeValue& node);
+
+    // 批量读取最新值缓存，只取一次快照与读锁；nodes与codes一一对应，无缓存的节点为空
+    void lastValues(std::span<const std::string> codes, std::vector<std::optional<NodeValue>>& nodes);
+
+    // 查询[from, to]内的历史数据，时间为Unix纪元毫秒；未启用历史记录时抛出异常
+    void history(const std::string& nodeCode, int64_t from, int64_t to, std::vector<HistoryPoint>& points);
 
-signals:
-    void newData(const std::string& topic,const std::string& code, const std::vector<std::pair<std::string,std::string>>& datas);
+    // 历史数据占用的内存(字节)与点数，未启用时均为0
+    std::pair<size_t, uint64_t> historyUsage();
 
-private slots:
+    void refreshNodeCache();
 
-    void connectServer();
+    // 推进连接、轮询与订阅状态，返回下一次需要处理的时间点
+    Clock::time_point process(Clock::time_point now);
+
+    // 是否有在途请求或活动订阅，需要引擎以较短间隔持续驱动
+    bool busy();
 
 private:
 
-    void run() override;
+    void processConnection(Clock::time_point now);
+
+    void onSessionActivated();
+
+    void scheduleReconnect(Clock::time_point now);
+
+    // 异步读取服务端启动时间，响应到达后判断服务端是否重启
+    void requestServerStartTime();
+
+    void updateServerStartTime(int64_t startTime);
+
+    // 会话被重新激活时异步恢复原订阅的发布，失败则重新创建
+    void resumeSubscription();
+
+    Clock::time_point processPolling(Clock::time_point now);
+
+    void processBrowse(Clock::time_point now);
+
+    static void fillNodeValue(const LastValue& entry, NodeValue& node);
+
+    void updateLastValue(const Sample& sample, const std::string& name);
+
+    void updateLastStatus(uint32_t index, uint32_t status, int64_t acquireTime);
+
+    void processSubscription();
+
+    // 一次Read请求异步解析监控节点的浏览名与数据类型，解析完成后下一轮再创建监控项
+    void resolveMonitoredNodes(std::vector<std::string> nodeCodes);
+
+    // 一次CreateMonitoredItems请求为nodeCodes创建监控项，结果在回调中处理
+    void createMonitoredItems(const NodeSet& snapshot, std::vector<std::string> nodeCodes);
+
+    // 一次DeleteMonitoredItems请求删除监控项，不等待结果
+    void deleteMonitoredItems(const std::vector<uint32_t>& monitoredItemIds);
+
+    void issueReadBatch(const std::shared_ptr<ReadCycle>& cycle);
+
+    void onReadResponse(const std::shared_ptr<ReadCycle>& cycle, size_t begin, size_t end, opcua::ReadResponse& response);
+
+    void processCommands(Clock::time_point now);
+
+    void issueWrite(const std::shared_ptr<WriteCommand>& command);
+
+    void failCommand(const std::shared_ptr<WriteCommand>& command, uint32_t status, const std::string& message);
+
+    void completeCommand(const std::shared_ptr<WriteCommand>& command);
+
+    bool hasPendingCommands();
+
+    void resetSession();
+
+    // 丢弃在途的读取、浏览与指令，会话失效或安全通道断开时调用
+    void abortRequests();
+
+    void resetSubscription();
 
     bool isConnected();
 
+    // 采集节点的缓存句柄，不存在时创建；只用于当前节点集合中的节点
+    NodeHandle& nodeHandle(const std::string& nodeCode);
+
+    // 解析节点Code得到未缓存的句柄，用于指令与实时读取中的非采集节点
+    NodeHandle createNodeHandle(const std::string& nodeCode);
+
+    // 移除不在节点集合中的缓存句柄，读取批次在途时推迟到批次结束后
+    void pruneNodeCache(const NodeSet& nodeSet);
+
+    // 在mNodeSetLocker保护下复制当前快照，修改后原子替换
+    void updateNodeSet(const std::function<void(NodeSet&)>& modifier);
+
+    void applyNodeSet(const NodeSet& nodeSet);
+
+    void resolveNodes(const std::vector<NodeHandle*>& handles);
+
+    void onResolveResponse(const std::vector<NodeHandle*>& handles, opcua::ReadResponse& response);
+
+    void invalidateNodeCache();
+
     std::string mUrl;
 
     std::string mMachineCode;
@@ -80,10 +378,140 @@ private:
 
     std::mutex mClientLocker;
 
-    std::set<std::string> mNodeCodes;
+    std::atomic<std::shared_ptr<const NodeSet>> mpNodeSet;
+
+    // 仅用于串行化写入方，读取方直接加载快照
+    std::mutex mNodeSetLocker;
+
+    // 工作线程已应用的快照版本，用于同步调度器周期
+    uint64_t mAppliedVersion = 0;
+
+    // 节点句柄缓存已按该版本的节点集合清理
+    uint64_t mPrunedVersion = 0;
+
+    // 采集节点的句柄缓存，由mClientLocker保护，重连或显式刷新时失效，移除的节点随之清理
+    std::unordered_map<std::string, NodeHandle> mNodeCache;
+
+    std::atomic<bool> mStarted = false;
+
+    std::atomic<bool> mBusy = false;
+
+    // 会话是否已激活，仅在持有mClientLocker时读写
+    bool mSessionActivated = false;
+
+    bool mConnecting = false;
+
+    // 安全通道断开后尚未重新激活会话
+    bool mReactivating = false;
+
+    Clock::time_point mConnectDeadline;
+
+    Clock::time_point mNextConnect;
+
+    std::atomic<ConnectionState> mConnectionState = ConnectionState::Disconnected;
+
+    std::atomic<uint32_t> mReconnectAttempts = 0;
+
+    std::chrono::milliseconds mReconnectMin{1000};
+
+    std::chrono::milliseconds mReconnectMax{30000};
+
+    std::mt19937 mRandom{std::random_device{}()};
+
+    // 服务端启动时间(UA_DateTime)，变化说明服务端已重启，节点缓存需要失效
+    int64_t mServerStartTime = 0;
+
+    // 会话激活后尚未返回的请求数，全部返回前不开始采集，由mClientLocker保护
+    int mActivationPending = 0;
 
-    QTimer* mpReconnectTimer = nullptr;
+    // 每次会话激活加一，上一会话的异步响应到达时据此丢弃
+    uint64_t mSessionEpoch = 0;
+
+    // 正在进行的轮询，同一时刻最多一个
+    std::shared_ptr<ReadCycle> mpReadCycle = nullptr;
+
+    std::optional<opcua::Subscription<opcua::Client>> mSubscription;
+
+    // 创建订阅的请求在途
+    bool mSubscriptionPending = false;
+
+    // 每次重置订阅加一，之前发出的订阅与监控项请求的响应据此丢弃
+    uint64_t mSubscriptionEpoch = 0;
+
+    // 节点Code -> 监控项ID
+    std::map<std::string, uint32_t> mMonitoredItems;
+
+    // 解析或创建监控项的请求在途的节点
+    std::set<std::string> mPendingItems;
+
+    // 创建监控项失败的节点不再重复尝试，直到其被移除后重新添加
+    std::set<std::string> mRejectedNodes;
+
+    // 已完成待发送的数据，回调可能在任意持锁线程中执行，统一由process发送
+    std::vector<std::vector<Sample>> mPendingDatas;
 
     std::atomic<int> mInterval = 1000;
+
+    // 单次Read请求携带的最大节点数，<=0表示不限制
+    std::atomic<int> mReadBatchSize = 500;
+
+    std::atomic<AcquisitionMode> mMode = AcquisitionMode::Poll;
+
+    // 订阅模式参数，单位ms
+    double mPublishingInterval = 1000;
+
+    // 服务端修正后的发布间隔，订阅存在时按此间隔调度下一次网络事件处理
+    double mRevisedPublishingInterval = 1000;
+
+    double mSamplingInterval = 500;
+
+    uint32_t mQueueSize = 1;
+
+    std::atomic<bool> mAlignToWallClock = false;
+
+    // 仅由调用process的工作线程使用
+    ReportFilter mReportFilter;
+
+    std::atomic<bool> mBackpressure = false;
+
+    std::atomic<int> mBackpressureInterval = 5000;
+
+    // 积压期间合并的样本，按字典下标保留最新值，仅由调用process的工作线程使用
+    std::map<uint32_t, Sample> mCoalescedSamples;
+
+    Clock::time_point mNextCoalescedEmit;
+
+    BrowseIndex mBrowseIndex;
+
+    // 由mClientLocker保护
+    BrowseCrawler mBrowseCrawler;
+
+    std::chrono::seconds mBrowseRefreshInterval{3600};
+
+    Clock::time_point mNextBrowse;
+
+    // 待发送的写入指令、唤醒回调与延迟统计，由mCommandLocker保护
+    std::mutex mCommandLocker;
+
+    std::deque<std::shared_ptr<WriteCommand>> mCommands;
+
+    std::function<void()> mWakeup;
+
+    std::shared_ptr<SampleRing> mpSampleRing = nullptr;
+
+    // 节点历史数据，未启用时为空
+    std::unique_ptr<History> mpHistory = nullptr;
+
+    // 最新值缓存，按节点字典下标存放，由轮询响应与订阅通知更新
+    std::shared_mutex mLastValueLocker;
+
+    std::vector<LastValue> mLastValues;
+
+    CommandStatistics mCommandStatistics;
+
+    // 已发送等待响应的指令，由mClientLocker保护
+    std::set<std::shared_ptr<WriteCommand>> mActiveCommands;
+
+    std::atomic<int> mCommandTimeout = 2000;
 };
 #endif //OPCCLIENT_OPCCLIENT_H
@@ -11,6 +11,9 @@
 #include "KafkaProducer.h"
 #include "cpp-httplib/httplib.h"
 #include "Machine.h"
+#include "IOEngine.h"
+#include <atomic>
+#include <memory>
 
 DECLARE_EXCEPTION(OPCClientNotExistException, ExistsException)
 DECLARE_EXCEPTION(HttpRuntimeError, RuntimeException)
@@ -40,19 +43,37 @@ private:
 
     void stopHttpServer();
 
+    // 按kafka_producer配置创建生产者分片及各自的环形队列
+    void createKafkaProducers(const YAML::Node& kafkaNode);
+
+    KafkaProducer* kafkaProducer(const std::string& code);
+
+    using MachineMap = std::unordered_map<std::string, std::shared_ptr<Machine>>;
+
+    // 当前设备表快照，不加锁
+    std::shared_ptr<const MachineMap> clients() const;
+
+    // 设备不存在时抛出OPCClientNotExistException，返回后调用方只持有该设备的引用
+    std::shared_ptr<Machine> findClient(const std::string& machine) const;
+
     std::string generateResponseContent(int code, const std::string &message, const std::string& data = "",bool isRaw = false);
 
     static OPCClient* mpInstance;
 
     static std::recursive_mutex mMutex;
 
-    std::unordered_map<std::string,std::shared_ptr<Machine>>mClients;
+    // 设备表只读快照，HTTP处理直接加载，新增设备时复制后整体替换
+    std::atomic<std::shared_ptr<const MachineMap>> mpClients;
 
+    // 加载配置时持有，保证mpClients的复制与替换不会相互覆盖；HTTP处理从不获取
     std::recursive_mutex mClientsMutex;
 
-    KafkaProducer* mpKafkaProducer = nullptr;
+    IOEngine* mpIOEngine = nullptr;
+
+    // 生产者分片，各自在独立线程中序列化与发送，设备按code哈希固定分配到一个分片
+    std::vector<KafkaProducer*> mKafkaProducers;
 
-    QThread* mpKafkaProducerThread = nullptr;
+    std::vector<QThread*> mKafkaProducerThreads;
 
     YAML::Node mConfig;
 
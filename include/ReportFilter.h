@@ -0,0 +1,83 @@
+//
+// Created by cumtzt on 25-3-24.
+//
+
+#ifndef REPORTFILTER_H
+#define REPORTFILTER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "Sample.h"
+
+// 死区类型：绝对值死区、按量程百分比死区
+enum class DeadbandType {
+    None,
+    Absolute,
+    Percent
+};
+
+struct Deadband {
+    DeadbandType type = DeadbandType::None;
+    double value = 0;
+    // 百分比死区使用的量程，未配置(low == high)时以上次上报值的绝对值为基准
+    double low = 0;
+    double high = 0;
+};
+
+// 按例外上报：质量码未变且数值在死区内、布尔与字符串未变化的节点不再上报，
+// 每隔心跳周期输出一次当前全部节点的最新值
+class ReportFilter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void setEnabled(bool enabled);
+
+    [[nodiscard]] bool enabled() const;
+
+    void setHeartbeat(std::chrono::seconds heartbeat);
+
+    void setDeadband(const std::string& code, const Deadband& deadband);
+
+    // 过滤一批采集数据，原地保留需要上报的部分；indices为当前节点集合，心跳只输出其中的节点
+    void filter(std::vector<Sample>& samples, const NodeDictionary& dictionary,
+                const std::unordered_map<std::string, uint32_t>& indices, Clock::time_point now);
+
+    // 清空上次上报记录，下一批数据全部上报
+    void reset();
+
+private:
+    struct Report {
+        // 死区比较基准：上次上报的值
+        Sample sample;
+        // 最近一次采集到的值，死区内被过滤时也更新，心跳输出此值
+        Sample latest;
+        Deadband deadband;
+        // 死区按节点下标缓存，配置版本变化后重新查找
+        uint64_t deadbandVersion = 0;
+        bool reported = false;
+    };
+
+    static bool changed(const Report& last, const Sample& current);
+
+    std::atomic<bool> mEnabled = false;
+
+    std::chrono::seconds mHeartbeat{0};
+
+    Clock::time_point mNextHeartbeat;
+
+    // 按节点下标索引的上次上报记录，只由调用filter的线程访问
+    std::vector<Report> mLastReports;
+
+    std::unordered_map<std::string, Deadband> mDeadbands;
+
+    uint64_t mDeadbandVersion = 1;
+
+    // 保护死区与心跳配置
+    std::mutex mDeadbandLocker;
+};
+
+#endif //REPORTFILTER_H
@@ -0,0 +1,60 @@
+//
+// Created by cumtzt on 25-3-26.
+//
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <string>
+#include <vector>
+#include <variant>
+#include <memory>
+#include <cstdint>
+
+// 采集值，保持OPC原生数值类型，文本格式化只在序列化边界进行。
+// 类型序号写入二进制消息，新类型只能追加在末尾
+using SampleValue = std::variant<std::monostate, bool, int32_t, uint32_t, int64_t, uint64_t, float, double, std::string,
+                                 int8_t, uint8_t, int16_t, uint16_t>;
+
+struct Sample {
+    // 节点在NodeDictionary中的下标
+    uint32_t index = 0;
+    SampleValue value;
+    // UA_StatusCode
+    uint32_t status = 0;
+    // 源时间戳与服务器时间戳，Unix纪元微秒，0表示服务器未提供
+    int64_t sourceTime = 0;
+    int64_t serverTime = 0;
+    // 读取响应或订阅通知返回时的本机时间，Unix纪元微秒
+    int64_t acquireTime = 0;
+};
+
+// 节点字典：下标到节点Code的映射，只追加不删除，下标在Machine生命周期内保持不变
+using NodeDictionary = std::vector<std::string>;
+
+struct SampleBatch {
+    std::shared_ptr<const NodeDictionary> dictionary;
+    std::vector<Sample> samples;
+    // 批次中最晚的采集时间，Unix纪元微秒
+    int64_t collectTime = 0;
+};
+
+// 本机当前时间，Unix纪元微秒
+int64_t currentUnixMicroseconds();
+
+// 样本时间：优先使用源时间戳，服务器未提供时使用采集时间
+int64_t sampleTimestamp(const Sample& sample);
+
+// 采集值的类型名称，与HTTP接口返回的type一致
+const char* sampleTypeName(const SampleValue& value);
+
+// 采集值格式化为文本，布尔值输出为"1"/"0"
+std::string formatSampleValue(const SampleValue& value);
+
+// 格式化结果直接追加到out，out容量足够时不分配内存
+void appendSampleValue(std::string& out, const SampleValue& value);
+
+// 数值类型转换为double，非数值返回false
+bool sampleToDouble(const SampleValue& value, double& number);
+
+#endif //SAMPLE_H
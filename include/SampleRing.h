@@ -0,0 +1,125 @@
+//
+// Created by cumtzt on 25-4-12.
+//
+
+#ifndef SAMPLERING_H
+#define SAMPLERING_H
+
+#include "Sample.h"
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+// 队列已满时的处理方式
+// 入队在共享I/O工作线程上进行，两种策略都不等待，避免一个设备积压阻塞同线程的其他设备
+enum class OverflowPolicy {
+    DropOldest,
+    // 按设备合并到队列外的待发批次，同一节点只保留最新值
+    Coalesce
+};
+
+struct BatchSlot {
+    std::string topic;
+    std::string code;
+    SampleBatch batch;
+};
+
+struct RingStatistics {
+    size_t capacity = 0;
+    // 当前队列中的批次数
+    size_t depth = 0;
+    size_t highWaterMark = 0;
+    uint64_t pushed = 0;
+    uint64_t dropped = 0;
+    uint64_t coalesced = 0;
+};
+
+// 采集线程到发送线程的有界多生产者单消费者环形队列。
+// 槽位预先分配，按槽位序号交接（Vyukov有界队列），入队出队只移动批次不复制；
+// drop_oldest时采集线程也会出队，因此出队同样按序号竞争。
+class SampleRing {
+public:
+    // 容量向上取整为2的幂
+    explicit SampleRing(size_t capacity, OverflowPolicy policy = OverflowPolicy::Coalesce);
+
+    SampleRing(SampleRing const&) = delete;
+
+    SampleRing& operator=(SampleRing const&) = delete;
+
+    // 队列由空变为非空时在采集线程中调用，须在采集开始前设置
+    void setNotify(std::function<void()> notify);
+
+    // 采集线程调用，同一设备的批次须来自同一线程以保持顺序
+    void push(const std::string& topic, const std::string& code, SampleBatch&& batch);
+
+    // 发送线程调用，取出最旧的批次；合并的批次在该设备此前入队的批次全部取出后返回
+    bool pop(BatchSlot& slot);
+
+    // 发送线程开始取出前调用，之后入队的批次会再次通知
+    void rearm();
+
+    bool empty();
+
+    size_t capacity() const;
+
+    RingStatistics statistics();
+
+private:
+    struct Cell {
+        std::atomic<uint64_t> sequence{0};
+        BatchSlot slot;
+    };
+
+    struct CoalescedBatch {
+        std::string topic;
+        SampleBatch batch;
+        // 开始合并时的入队位置，出队位置到达后才能取出
+        uint64_t ticket = 0;
+    };
+
+    bool tryPush(const std::string& topic, const std::string& code, SampleBatch& batch);
+
+    bool tryPop(BatchSlot& slot);
+
+    bool popCoalesced(BatchSlot& slot);
+
+    // 持有mCoalesceLocker时调用，source中的节点覆盖target中的同一节点
+    static void merge(SampleBatch& target, SampleBatch&& source);
+
+    void notify();
+
+    std::unique_ptr<Cell[]> mCells;
+
+    size_t mMask = 0;
+
+    OverflowPolicy mPolicy;
+
+    std::function<void()> mNotify;
+
+    std::atomic<bool> mNotified = false;
+
+    alignas(64) std::atomic<uint64_t> mEnqueuePos = 0;
+
+    alignas(64) std::atomic<uint64_t> mDequeuePos = 0;
+
+    alignas(64) std::atomic<size_t> mHighWaterMark = 0;
+
+    std::atomic<uint64_t> mPushed = 0;
+
+    std::atomic<uint64_t> mDropped = 0;
+
+    std::atomic<uint64_t> mCoalesced = 0;
+
+    std::mutex mCoalesceLocker;
+
+    // 设备code -> 合并中的批次，只在队列已满后使用
+    std::unordered_map<std::string, CoalescedBatch> mCoalescedBatches;
+
+    std::atomic<size_t> mCoalescedCount = 0;
+};
+
+#endif //SAMPLERING_H
@@ -0,0 +1,72 @@
+//
+// Created by cumtzt on 25-3-18.
+//
+
+#ifndef SCANSCHEDULER_H
+#define SCANSCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// 采集周期统计，时间单位均为微秒
+struct ScanStatistics {
+    uint64_t cycles = 0;
+    // 因单周期执行超时而被跳过的触发点数
+    uint64_t overruns = 0;
+    int64_t lastJitter = 0;
+    int64_t minJitter = 0;
+    int64_t maxJitter = 0;
+    double meanJitter = 0;
+    int64_t lastDuration = 0;
+    int64_t minDuration = 0;
+    int64_t maxDuration = 0;
+    double meanDuration = 0;
+};
+
+// 固定频率调度器：按绝对时间点触发，周期不随执行耗时漂移
+class ScanScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ScanScheduler(std::chrono::milliseconds period = std::chrono::milliseconds(1000),
+                           bool alignToWallClock = false);
+
+    void setPeriod(std::chrono::milliseconds period);
+
+    [[nodiscard]] std::chrono::milliseconds period() const;
+
+    void setAlignToWallClock(bool align);
+
+    [[nodiscard]] bool alignToWallClock() const;
+
+    // 重新计算首个触发点并清空统计
+    void reset();
+
+    [[nodiscard]] Clock::time_point nextDeadline() const;
+
+    [[nodiscard]] bool due(Clock::time_point now) const;
+
+    // 周期开始，记录相对触发点的抖动
+    void begin(Clock::time_point now);
+
+    // 周期结束，记录执行耗时并推进到下一个未错过的触发点
+    void end(Clock::time_point now);
+
+    [[nodiscard]] ScanStatistics statistics() const;
+
+private:
+    std::chrono::milliseconds mPeriod;
+
+    bool mAlignToWallClock = false;
+
+    Clock::time_point mDeadline;
+
+    Clock::time_point mBegin;
+
+    ScanStatistics mStatistics;
+
+    mutable std::mutex mStatisticsLocker;
+};
+
+#endif //SCANSCHEDULER_H
@@ -0,0 +1,141 @@
+//
+// Created by cumtzt on 25-4-8.
+//
+
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <QFile>
+#include <string>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+// 计算CRC32(IEEE 802.3)，crc为上一段的结果，用于分段累加
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+// 本地落盘队列：只追加的内存映射段文件，每条记录带CRC校验，
+// 按写入顺序读取，确认后才移除，超过磁盘上限时从最旧的段开始淘汰
+class Spool {
+public:
+    Spool() = default;
+
+    Spool(Spool const&) = delete;
+
+    Spool& operator=(Spool const&) = delete;
+
+    ~Spool();
+
+    // 打开目录并恢复已有段文件与读取位置
+    bool open(const std::string& dir, size_t segmentBytes, size_t maxBytes);
+
+    bool isOpen();
+
+    // key可为空，topic与key不超过65535字节
+    bool append(const std::string& topic, const std::string& key, const std::string& payload);
+
+    // 读取下一条未发出的记录但不移动读取位置，发出后调用advance
+    bool peek(std::string& topic, std::string& key, std::string& payload);
+
+    // 读取位置越过peek返回的记录，返回记录序号；记录在commit之前仍保留在队列中
+    uint64_t advance();
+
+    // 确认最旧的已发出记录，序号与之不符(如所在段已被淘汰)时忽略
+    void commit(uint64_t id);
+
+    // 未确认的记录全部退回，从最旧的未确认记录开始重新读取
+    void rewind();
+
+    bool empty();
+
+    // 段文件占用的磁盘空间
+    size_t diskBytes();
+
+    // 因超出磁盘上限被淘汰的段数
+    uint64_t evictedSegments();
+
+private:
+    struct RecordHeader {
+        uint32_t magic;
+        uint32_t crc;
+        // 记录体依次为topic、key、payload
+        uint16_t topicSize;
+        uint16_t keySize;
+        uint32_t payloadSize;
+    };
+
+    static constexpr uint32_t RecordMagic = 0x4C4F5053;
+
+    [[nodiscard]] std::string segmentPath(uint64_t sequence) const;
+
+    bool openWriter(size_t size);
+
+    void closeWriter();
+
+    bool openReader();
+
+    void closeReader();
+
+    // 删除最旧的段，读取位置移动到下一段开头
+    void removeFront();
+
+    void evict();
+
+    void saveCursor();
+
+    std::mutex mLocker;
+
+    std::string mDir;
+
+    size_t mSegmentBytes = 16 * 1024 * 1024;
+
+    size_t mMaxBytes = 1024 * 1024 * 1024;
+
+    bool mOpened = false;
+
+    // 磁盘上的段序号，升序
+    std::deque<uint64_t> mSegments;
+
+    uint64_t mNextSequence = 1;
+
+    size_t mDiskBytes = 0;
+
+    uint64_t mEvictedSegments = 0;
+
+    // 当前写入段，文件按段大小预分配后映射，关闭时截断到实际长度
+    std::unique_ptr<QFile> mpWriteFile = nullptr;
+
+    uchar* mpWriteData = nullptr;
+
+    uint64_t mWriteSequence = 0;
+
+    qint64 mWriteSize = 0;
+
+    qint64 mWriteOffset = 0;
+
+    // 读取段为最旧的段，与写入段相同时直接使用写入映射；mReadOffset为已确认位置，持久化到cursor文件
+    std::unique_ptr<QFile> mpReadFile = nullptr;
+
+    const uchar* mpReadData = nullptr;
+
+    qint64 mReadSize = 0;
+
+    qint64 mReadOffset = 0;
+
+    // 读取位置，mReadOffset之后已发出但未确认的记录不会重复读取；只在最旧的段内前进
+    qint64 mNextOffset = 0;
+
+    // peek返回的记录长度
+    qint64 mPeekSize = 0;
+
+    // 已发出未确认的记录：(序号, 长度)，按读取顺序
+    std::deque<std::pair<uint64_t, qint64>> mOutstanding;
+
+    uint64_t mNextRecordId = 1;
+
+    // 距上次保存确认位置以来确认的记录数
+    uint32_t mCommitsSinceCursor = 0;
+};
+
+#endif //SPOOL_H
@@ -0,0 +1,442 @@
+//
+// Created by cumtzt on 25-4-10.
+//
+#include "BinaryCodec.h"
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <cstring>
+
+namespace
+{
+    constexpr char RecordMagic[4] = {'O', 'P', 'C', 'B'};
+
+    // 记录头：magic、版本、标志与记录体长度
+    constexpr size_t RecordHeaderSize = 4 + 1 + 1 + 4;
+
+    constexpr uint8_t TypeMask = 0x0F;
+
+    constexpr uint8_t HasStatus = 0x80;
+
+    constexpr uint8_t HasSourceTime = 0x40;
+
+    void putU8(std::string& out, uint8_t value)
+    {
+        out.push_back(static_cast<char>(value));
+    }
+
+    void putU16(std::string& out, uint16_t value)
+    {
+        out.push_back(static_cast<char>(value));
+        out.push_back(static_cast<char>(value >> 8));
+    }
+
+    void putU32(std::string& out, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            out.push_back(static_cast<char>(value >> (8 * i)));
+        }
+    }
+
+    void putU64(std::string& out, uint64_t value)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            out.push_back(static_cast<char>(value >> (8 * i)));
+        }
+    }
+
+    void putVarint(std::string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    // 越界时置failed，后续读取均返回0
+    struct Reader {
+        const uint8_t* data;
+        size_t size;
+        size_t offset = 0;
+        bool failed = false;
+
+        bool require(size_t n)
+        {
+            if (failed || size - offset < n)
+            {
+                failed = true;
+                return false;
+            }
+            return true;
+        }
+
+        uint8_t u8()
+        {
+            return require(1) ? data[offset++] : 0;
+        }
+
+        uint16_t u16()
+        {
+            if (!require(2))
+            {
+                return 0;
+            }
+            auto value = static_cast<uint16_t>(data[offset] | (data[offset + 1] << 8));
+            offset += 2;
+            return value;
+        }
+
+        uint32_t u32()
+        {
+            if (!require(4))
+            {
+                return 0;
+            }
+            uint32_t value = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                value |= static_cast<uint32_t>(data[offset++]) << (8 * i);
+            }
+            return value;
+        }
+
+        uint64_t u64()
+        {
+            if (!require(8))
+            {
+                return 0;
+            }
+            uint64_t value = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                value |= static_cast<uint64_t>(data[offset++]) << (8 * i);
+            }
+            return value;
+        }
+
+        uint64_t varint()
+        {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                auto byte = u8();
+                if (failed)
+                {
+                    return 0;
+                }
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (0 == (byte & 0x80))
+                {
+                    return value;
+                }
+            }
+            failed = true;
+            return 0;
+        }
+    };
+
+    uint64_t zigzag(int64_t value)
+    {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value)
+    {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    void encodeValue(const SampleValue& value, std::string& out)
+    {
+        switch (value.index())
+        {
+        case 1:
+            putU8(out, std::get<bool>(value) ? 1 : 0);
+            break;
+        case 2:
+            putU32(out, static_cast<uint32_t>(std::get<int32_t>(value)));
+            break;
+        case 3:
+            putU32(out, std::get<uint32_t>(value));
+            break;
+        case 4:
+            putU64(out, static_cast<uint64_t>(std::get<int64_t>(value)));
+            break;
+        case 5:
+            putU64(out, std::get<uint64_t>(value));
+            break;
+        case 6:
+            {
+                uint32_t bits;
+                auto number = std::get<float>(value);
+                std::memcpy(&bits, &number, sizeof(bits));
+                putU32(out, bits);
+                break;
+            }
+        case 7:
+            {
+                uint64_t bits;
+                auto number = std::get<double>(value);
+                std::memcpy(&bits, &number, sizeof(bits));
+                putU64(out, bits);
+                break;
+            }
+        case 8:
+            {
+                const auto& text = std::get<std::string>(value);
+                putVarint(out, text.size());
+                out.append(text);
+                break;
+            }
+        case 9:
+            putU8(out, static_cast<uint8_t>(std::get<int8_t>(value)));
+            break;
+        case 10:
+            putU8(out, std::get<uint8_t>(value));
+            break;
+        case 11:
+            putU16(out, static_cast<uint16_t>(std::get<int16_t>(value)));
+            break;
+        case 12:
+            putU16(out, std::get<uint16_t>(value));
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool decodeValue(uint8_t type, Reader& reader, SampleValue& value)
+    {
+        switch (type)
+        {
+        case 0:
+            value = std::monostate{};
+            break;
+        case 1:
+            value = 0 != reader.u8();
+            break;
+        case 2:
+            value = static_cast<int32_t>(reader.u32());
+            break;
+        case 3:
+            value = reader.u32();
+            break;
+        case 4:
+            value = static_cast<int64_t>(reader.u64());
+            break;
+        case 5:
+            value = reader.u64();
+            break;
+        case 6:
+            {
+                auto bits = reader.u32();
+                float number;
+                std::memcpy(&number, &bits, sizeof(number));
+                value = number;
+                break;
+            }
+        case 7:
+            {
+                auto bits = reader.u64();
+                double number;
+                std::memcpy(&number, &bits, sizeof(number));
+                value = number;
+                break;
+            }
+        case 8:
+            {
+                auto length = reader.varint();
+                if (!reader.require(length))
+                {
+                    return false;
+                }
+                value = std::string(reinterpret_cast<const char*>(reader.data + reader.offset), length);
+                reader.offset += length;
+                break;
+            }
+        case 9:
+            value = static_cast<int8_t>(reader.u8());
+            break;
+        case 10:
+            value = reader.u8();
+            break;
+        case 11:
+            value = static_cast<int16_t>(reader.u16());
+            break;
+        case 12:
+            value = reader.u16();
+            break;
+        default:
+            return false;
+        }
+        return !reader.failed;
+    }
+}
+
+uint32_t binaryDictionaryId(const std::string& source)
+{
+    uint32_t hash = 2166136261u;
+    for (auto c : source)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void encodeBinaryRecord(uint32_t dictionaryId, uint32_t dictionarySize, int64_t collectTime,
+                        std::span<const Sample> samples, std::string& out)
+{
+    const auto begin = out.size();
+    out.append(RecordMagic, sizeof(RecordMagic));
+    putU8(out, BinarySchemaVersion);
+    putU8(out, 0);
+    // 记录体长度在写完后回填
+    putU32(out, 0);
+    putU32(out, dictionaryId);
+    putU32(out, dictionarySize);
+    putU64(out, static_cast<uint64_t>(collectTime));
+    putVarint(out, samples.size());
+    for (const auto& sample : samples)
+    {
+        putVarint(out, sample.index);
+        auto tag = static_cast<uint8_t>(sample.value.index() & TypeMask);
+        if (0 != sample.status)
+        {
+            tag |= HasStatus;
+        }
+        if (0 != sample.sourceTime)
+        {
+            tag |= HasSourceTime;
+        }
+        putU8(out, tag);
+        encodeValue(sample.value, out);
+        if (0 != sample.status)
+        {
+            putU32(out, sample.status);
+        }
+        if (0 != sample.sourceTime)
+        {
+            putVarint(out, zigzag(sample.sourceTime - collectTime));
+        }
+    }
+    auto bodySize = static_cast<uint32_t>(out.size() - begin - RecordHeaderSize);
+    for (int i = 0; i < 4; i++)
+    {
+        out[begin + 6 + i] = static_cast<char>(bodySize >> (8 * i));
+    }
+}
+
+bool decodeBinaryRecords(const char* data, size_t size, std::vector<BinaryRecord>& records, std::string& error)
+{
+    Reader reader{reinterpret_cast<const uint8_t*>(data), size};
+    while (reader.offset < size)
+    {
+        if (!reader.require(RecordHeaderSize) ||
+            0 != std::memcmp(reader.data + reader.offset, RecordMagic, sizeof(RecordMagic)))
+        {
+            error = "记录头无效，偏移" + std::to_string(reader.offset);
+            return false;
+        }
+        reader.offset += sizeof(RecordMagic);
+        auto version = reader.u8();
+        reader.u8();
+        auto bodySize = reader.u32();
+        if (BinarySchemaVersion != version)
+        {
+            error = "不支持的格式版本" + std::to_string(version);
+            return false;
+        }
+        if (!reader.require(bodySize))
+        {
+            error = "记录体不完整，偏移" + std::to_string(reader.offset);
+            return false;
+        }
+        // 记录体单独解析，越界不会读到下一条记录
+        Reader body{reader.data + reader.offset, bodySize};
+        reader.offset += bodySize;
+        BinaryRecord record;
+        record.dictionaryId = body.u32();
+        record.dictionarySize = body.u32();
+        record.collectTime = static_cast<int64_t>(body.u64());
+        auto count = body.varint();
+        // 每个样本至少占两个字节
+        if (body.failed || count > bodySize / 2)
+        {
+            error = "样本数无效";
+            return false;
+        }
+        record.samples.reserve(count);
+        for (uint64_t i = 0; i < count; i++)
+        {
+            Sample sample;
+            sample.index = static_cast<uint32_t>(body.varint());
+            auto tag = body.u8();
+            if (!decodeValue(tag & TypeMask, body, sample.value))
+            {
+                error = "样本" + std::to_string(i) + "解析失败";
+                return false;
+            }
+            if (tag & HasStatus)
+            {
+                sample.status = body.u32();
+            }
+            if (tag & HasSourceTime)
+            {
+                sample.sourceTime = record.collectTime + unzigzag(body.varint());
+            }
+            if (body.failed)
+            {
+                error = "样本" + std::to_string(i) + "不完整";
+                return false;
+            }
+            record.samples.push_back(std::move(sample));
+        }
+        records.push_back(std::move(record));
+    }
+    return true;
+}
+
+std::string encodeBinaryDictionary(uint32_t id, const std::string& source, const NodeDictionary& nodes)
+{
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer writer(sb);
+    writer.StartObject();
+    writer.Key("schema");writer.Uint(BinarySchemaVersion);
+    writer.Key("id");writer.Uint(id);
+    writer.Key("source");writer.String(source.c_str(), source.size());
+    writer.Key("nodes");
+    writer.StartArray();
+    for (const auto& node : nodes)
+    {
+        writer.String(node.c_str(), node.size());
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return {sb.GetString(), sb.GetSize()};
+}
+
+bool decodeBinaryDictionary(const std::string& json, BinaryDictionary& dictionary)
+{
+    rapidjson::Document document;
+    document.Parse(json.c_str(), json.size());
+    if (document.HasParseError() || !document.IsObject() || !document.HasMember("id") ||
+        !document["id"].IsUint() || !document.HasMember("nodes") || !document["nodes"].IsArray())
+    {
+        return false;
+    }
+    dictionary.id = document["id"].GetUint();
+    if (document.HasMember("source") && document["source"].IsString())
+    {
+        dictionary.source = document["source"].GetString();
+    }
+    dictionary.nodes.clear();
+    for (auto& node : document["nodes"].GetArray())
+    {
+        dictionary.nodes.emplace_back(node.IsString() ? node.GetString() : "");
+    }
+    return true;
+}
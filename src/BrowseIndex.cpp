@@ -0,0 +1,411 @@
+//
+// Created by cumtzt on 25-3-28.
+//
+#include "BrowseIndex.h"
+#include "Logger.h"
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+BrowseIndex::~BrowseIndex()
+{
+    // 写入线程退出前需要获取mSaveLocker，此处不能持有
+    if (mSaveThread.joinable())
+    {
+        mSaveThread.join();
+    }
+}
+
+void BrowseIndex::setCacheFile(const std::string& file)
+{
+    std::scoped_lock lock(mFileLocker);
+    mCacheFile = file;
+}
+
+bool BrowseIndex::load()
+{
+    std::scoped_lock lock(mFileLocker);
+    if (mCacheFile.empty())
+    {
+        return false;
+    }
+    std::ifstream in(mCacheFile);
+    if (!in.is_open())
+    {
+        return false;
+    }
+    std::stringstream content;
+    content << in.rdbuf();
+    rapidjson::Document document;
+    document.Parse(content.str().c_str());
+    if (document.HasParseError() || !document.IsObject() || !document.HasMember("nodes") ||
+        !document["nodes"].IsArray())
+    {
+        LogWarn("浏览索引缓存[{}]格式错误，忽略", mCacheFile);
+        return false;
+    }
+    if (document.HasMember("time") && !document["time"].IsInt64())
+    {
+        LogWarn("浏览索引缓存[{}]格式错误，忽略", mCacheFile);
+        return false;
+    }
+    auto entries = std::make_shared<std::vector<BrowseEntry>>();
+    entries->reserve(document["nodes"].Size());
+    for (auto&& node : document["nodes"].GetArray())
+    {
+        // 任一节点字段缺失或类型不符即视为缓存损坏，整体丢弃，等待重新浏览
+        if (!node.IsObject() || !node.HasMember("code") || !node["code"].IsString() ||
+            !node.HasMember("path") || !node["path"].IsString() ||
+            (node.HasMember("class") && !node["class"].IsUint()) ||
+            (node.HasMember("type") && !node["type"].IsString()))
+        {
+            LogWarn("浏览索引缓存[{}]格式错误，忽略", mCacheFile);
+            return false;
+        }
+        BrowseEntry entry;
+        entry.code = node["code"].GetString();
+        entry.path = node["path"].GetString();
+        entry.nodeClass = node.HasMember("class") ? node["class"].GetUint() : 0;
+        entry.dataType = node.HasMember("type") ? node["type"].GetString() : "";
+        entries->push_back(std::move(entry));
+    }
+    mpEntries.store(std::move(entries));
+    mUpdateTime = document.HasMember("time") ? document["time"].GetInt64() : 0;
+    LogInfo("从[{}]加载浏览索引，节点数：{}", mCacheFile, mpEntries.load()->size());
+    return true;
+}
+
+bool BrowseIndex::save() const
+{
+    std::scoped_lock lock(mFileLocker);
+    auto entries = mpEntries.load();
+    if (mCacheFile.empty() || nullptr == entries)
+    {
+        return false;
+    }
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer writer(sb);
+    writer.StartObject();
+    writer.Key("time");writer.Int64(mUpdateTime);
+    writer.Key("nodes");
+    writer.StartArray();
+    for (auto&& entry : *entries)
+    {
+        writer.StartObject();
+        writer.Key("code");writer.String(entry.code.c_str(), entry.code.size());
+        writer.Key("path");writer.String(entry.path.c_str(), entry.path.size());
+        writer.Key("class");writer.Uint(entry.nodeClass);
+        writer.Key("type");writer.String(entry.dataType.c_str(), entry.dataType.size());
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    // 先写临时文件再替换，避免中途退出留下损坏的缓存
+    std::error_code ec;
+    auto path = std::filesystem::path(mCacheFile);
+    if (path.has_parent_path())
+    {
+        std::filesystem::create_directories(path.parent_path(), ec);
+    }
+    auto temp = mCacheFile + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::trunc);
+        if (!out.is_open())
+        {
+            LogErr("写入浏览索引缓存[{}]失败", temp);
+            return false;
+        }
+        out.write(sb.GetString(), static_cast<std::streamsize>(sb.GetSize()));
+    }
+    std::filesystem::rename(temp, mCacheFile, ec);
+    if (ec)
+    {
+        LogErr("写入浏览索引缓存[{}]失败：{}", mCacheFile, ec.message());
+        return false;
+    }
+    return true;
+}
+
+void BrowseIndex::saveAsync()
+{
+    std::scoped_lock lock(mSaveLocker);
+    mSaveRequested = true;
+    if (mSaving)
+    {
+        // 写入线程结束前会再次保存最新索引
+        return;
+    }
+    if (mSaveThread.joinable())
+    {
+        // 上一个写入线程已退出循环，join立即返回
+        mSaveThread.join();
+    }
+    mSaving = true;
+    mSaveThread = std::thread([this]()
+    {
+        while (true)
+        {
+            {
+                std::scoped_lock saveLock(mSaveLocker);
+                if (!mSaveRequested)
+                {
+                    mSaving = false;
+                    return;
+                }
+                mSaveRequested = false;
+            }
+            save();
+        }
+    });
+}
+
+void BrowseIndex::replace(std::vector<BrowseEntry> entries, int64_t updateTime)
+{
+    mpEntries.store(std::make_shared<const std::vector<BrowseEntry>>(std::move(entries)));
+    mUpdateTime = updateTime;
+}
+
+std::shared_ptr<const std::vector<BrowseEntry>> BrowseIndex::entries() const
+{
+    auto entries = mpEntries.load();
+    if (nullptr == entries)
+    {
+        static const auto empty = std::make_shared<const std::vector<BrowseEntry>>();
+        return empty;
+    }
+    return entries;
+}
+
+int64_t BrowseIndex::updateTime() const
+{
+    return mUpdateTime;
+}
+
+BrowseCrawler::BrowseCrawler(size_t maxNodes, size_t batchSize, size_t maxInFlight) :
+    mMaxNodes(maxNodes), mBatchSize(std::max<size_t>(batchSize, 1)), mMaxInFlight(std::max<size_t>(maxInFlight, 1))
+{
+}
+
+void BrowseCrawler::start(opcua::Client& client)
+{
+    cancel();
+    mRunning = true;
+    mPending.emplace_back(opcua::NodeId(0, UA_NS0ID_OBJECTSFOLDER), "");
+    mVisited.insert(opcua::NodeId(0, UA_NS0ID_OBJECTSFOLDER).toString());
+    browse(client);
+}
+
+bool BrowseCrawler::running() const
+{
+    return mRunning;
+}
+
+void BrowseCrawler::cancel()
+{
+    (*mpGeneration)++;
+    mRunning = false;
+    mInFlight = 0;
+    mPending.clear();
+    mVisited.clear();
+    mEntries.clear();
+    mVariables.clear();
+    mNextVariable = 0;
+}
+
+std::vector<BrowseEntry> BrowseCrawler::takeEntries()
+{
+    auto entries = std::move(mEntries);
+    cancel();
+    return entries;
+}
+
+bool BrowseCrawler::step(opcua::Client& client)
+{
+    if (!mRunning)
+    {
+        return false;
+    }
+    if (!mPending.empty())
+    {
+        browse(client);
+        return false;
+    }
+    if (mNextVariable < mVariables.size())
+    {
+        readDataTypes(client);
+        return false;
+    }
+    return 0 == mInFlight;
+}
+
+std::string BrowseCrawler::nodeCode(const opcua::NodeId& id)
+{
+    if (id.identifierType() == opcua::NodeIdType::Numeric)
+    {
+        return fmt::format("{}:{}", id.namespaceIndex(), id.identifier<uint32_t>());
+    }
+    return id.toString();
+}
+
+void BrowseCrawler::browse(opcua::Client& client)
+{
+    while (mInFlight < mMaxInFlight && !mPending.empty())
+    {
+        std::vector<opcua::BrowseDescription> descriptions;
+        std::vector<std::string> paths;
+        while (descriptions.size() < mBatchSize && !mPending.empty())
+        {
+            auto& [id, path] = mPending.front();
+            descriptions.emplace_back(id, opcua::BrowseDirection::Forward,
+                                      opcua::ReferenceTypeId::HierarchicalReferences, true,
+                                      UA_NODECLASS_UNSPECIFIED, opcua::BrowseResultMask::All);
+            paths.push_back(std::move(path));
+            mPending.pop_front();
+        }
+        opcua::BrowseRequest request(opcua::RequestHeader{}, opcua::ViewDescription{}, 0, descriptions);
+        auto generation = *mpGeneration;
+        try
+        {
+            opcua::services::browseAsync(client, request,
+                [this, &client, generation, paths = std::move(paths), gen = mpGeneration](opcua::BrowseResponse& response)
+                {
+                    if (*gen != generation)
+                    {
+                        return;
+                    }
+                    mInFlight--;
+                    if (response.responseHeader().serviceResult().isBad())
+                    {
+                        LogErr("浏览地址空间失败：{}", response.responseHeader().serviceResult().name());
+                        return;
+                    }
+                    auto results = response.results();
+                    for (size_t i = 0; i < results.size() && i < paths.size(); i++)
+                    {
+                        onBrowseResult(client, results[i], paths[i]);
+                    }
+                });
+        }
+        catch (std::exception& e)
+        {
+            abort(e);
+            return;
+        }
+        // 请求发出成功后才计入在途数量
+        mInFlight++;
+    }
+}
+
+void BrowseCrawler::abort(const std::exception& e)
+{
+    // 请求未能发出(如通道已关闭)时放弃本轮遍历，由调用方稍后重新开始
+    LogErr("浏览地址空间请求发送失败，放弃本轮浏览：{}", e.what());
+    cancel();
+}
+
+void BrowseCrawler::onBrowseResult(opcua::Client& client, const opcua::BrowseResult& result, const std::string& path)
+{
+    if (!mRunning || result.statusCode().isBad())
+    {
+        return;
+    }
+    for (auto&& reference : result.references())
+    {
+        const auto& id = reference.nodeId().nodeId();
+        auto idString = id.toString();
+        if (mVisited.size() >= mMaxNodes || mVisited.contains(idString))
+        {
+            continue;
+        }
+        mVisited.insert(idString);
+        BrowseEntry entry;
+        entry.code = nodeCode(id);
+        entry.path = path + "/" + std::string(reference.browseName().name());
+        entry.nodeClass = static_cast<uint32_t>(reference.nodeClass());
+        if (reference.nodeClass() == opcua::NodeClass::Variable)
+        {
+            mVariables.emplace_back(mEntries.size(), id);
+        }
+        mPending.emplace_back(id, entry.path);
+        mEntries.push_back(std::move(entry));
+    }
+    if (!result.continuationPoint().empty())
+    {
+        // 服务器分页返回的剩余引用
+        opcua::BrowseNextRequest request(opcua::RequestHeader{}, false, {result.continuationPoint()});
+        auto generation = *mpGeneration;
+        try
+        {
+            opcua::services::browseNextAsync(client, request,
+                [this, &client, generation, path, gen = mpGeneration](opcua::BrowseNextResponse& response)
+                {
+                    if (*gen != generation)
+                    {
+                        return;
+                    }
+                    mInFlight--;
+                    for (auto&& next : response.results())
+                    {
+                        onBrowseResult(client, next, path);
+                    }
+                });
+        }
+        catch (std::exception& e)
+        {
+            abort(e);
+            return;
+        }
+        mInFlight++;
+    }
+}
+
+void BrowseCrawler::readDataTypes(opcua::Client& client)
+{
+    while (mInFlight < mMaxInFlight && mNextVariable < mVariables.size())
+    {
+        const size_t begin = mNextVariable;
+        const size_t end = std::min(begin + mBatchSize, mVariables.size());
+        std::vector<opcua::ReadValueId> readIds;
+        readIds.reserve(end - begin);
+        for (size_t i = begin; i < end; i++)
+        {
+            readIds.emplace_back(mVariables[i].second, opcua::AttributeId::DataType);
+        }
+        mNextVariable = end;
+        opcua::ReadRequest request(opcua::RequestHeader{}, 0.0, opcua::TimestampsToReturn::Neither, readIds);
+        auto generation = *mpGeneration;
+        try
+        {
+            opcua::services::readAsync(client, request,
+                [this, generation, begin, end, gen = mpGeneration](opcua::ReadResponse& response)
+                {
+                    if (*gen != generation)
+                    {
+                        return;
+                    }
+                    mInFlight--;
+                    auto results = response.results();
+                    for (size_t i = begin; i < end && i - begin < results.size(); i++)
+                    {
+                        const auto& dataValue = results[i - begin];
+                        if (!dataValue.hasValue() || (dataValue.hasStatus() && dataValue.status().isBad()))
+                        {
+                            continue;
+                        }
+                        auto typeId = dataValue.value().to<opcua::NodeId>();
+                        const UA_DataType* type = UA_findDataType(typeId.handle());
+                        mEntries[mVariables[i].first].dataType = nullptr != type ? type->typeName : typeId.toString();
+                    }
+                });
+        }
+        catch (std::exception& e)
+        {
+            abort(e);
+            return;
+        }
+        mInFlight++;
+    }
+}
@@ -0,0 +1,369 @@
+//
+// Created by cumtzt on 25-4-14.
+//
+#include "History.h"
+#include <bit>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // 每块1KB，写入前预留单点最坏情况(4+64+2+5+6+64位)的空间
+    constexpr size_t BlockWords = 128;
+
+    constexpr size_t BlockBits = BlockWords * 64;
+
+    constexpr size_t PointMaxBits = 160;
+
+    uint64_t doubleBits(double value)
+    {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    double bitsDouble(uint64_t bits)
+    {
+        double value = 0;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    int64_t signExtend(uint64_t value, int bits)
+    {
+        auto shift = 64 - bits;
+        return static_cast<int64_t>(value << shift) >> shift;
+    }
+
+    // 布尔值记为0/1，字符串等非数值不记录
+    bool historyValue(const SampleValue& value, double& number)
+    {
+        if (std::holds_alternative<bool>(value))
+        {
+            number = std::get<bool>(value) ? 1.0 : 0.0;
+            return true;
+        }
+        return sampleToDouble(value, number);
+    }
+
+    class BitReader
+    {
+    public:
+        explicit BitReader(const std::vector<uint64_t>& words) : mWords(words)
+        {
+        }
+
+        uint64_t read(int bits)
+        {
+            if (0 == bits)
+            {
+                return 0;
+            }
+            auto word = mPosition / 64;
+            auto offset = static_cast<int>(mPosition % 64);
+            auto free = 64 - offset;
+            uint64_t value;
+            if (bits <= free)
+            {
+                value = mWords[word] >> (free - bits);
+            }
+            else
+            {
+                value = (mWords[word] << (bits - free)) | (mWords[word + 1] >> (64 - (bits - free)));
+            }
+            mPosition += bits;
+            return bits < 64 ? value & ((uint64_t(1) << bits) - 1) : value;
+        }
+
+        bool readBit()
+        {
+            return 1 == read(1);
+        }
+
+    private:
+        const std::vector<uint64_t>& mWords;
+
+        size_t mPosition = 0;
+    };
+}
+
+HistoryBlock::HistoryBlock()
+{
+    mWords.reserve(BlockWords);
+}
+
+bool HistoryBlock::append(int64_t time, double value)
+{
+    if (mBitSize + PointMaxBits > BlockBits)
+    {
+        return false;
+    }
+    auto bits = doubleBits(value);
+    if (0 == mCount)
+    {
+        write(static_cast<uint64_t>(time), 64);
+        write(bits, 64);
+        mStartTime = time;
+        mLastTime = time;
+        mLastDelta = 0;
+        mLastValue = bits;
+        mCount++;
+        return true;
+    }
+    // 时间戳：与上一间隔的差值按范围分桶，采集周期稳定时每点只占1位
+    auto delta = time - mLastTime;
+    auto deltaOfDelta = delta - mLastDelta;
+    if (0 == deltaOfDelta)
+    {
+        write(0b0, 1);
+    }
+    else if (deltaOfDelta >= -64 && deltaOfDelta <= 63)
+    {
+        write(0b10, 2);
+        write(static_cast<uint64_t>(deltaOfDelta), 7);
+    }
+    else if (deltaOfDelta >= -256 && deltaOfDelta <= 255)
+    {
+        write(0b110, 3);
+        write(static_cast<uint64_t>(deltaOfDelta), 9);
+    }
+    else if (deltaOfDelta >= -2048 && deltaOfDelta <= 2047)
+    {
+        write(0b1110, 4);
+        write(static_cast<uint64_t>(deltaOfDelta), 12);
+    }
+    else
+    {
+        write(0b1111, 4);
+        write(static_cast<uint64_t>(deltaOfDelta), 64);
+    }
+    // 数值：与上一值异或，相同时只占1位，有效位落在上一窗口内时复用窗口
+    auto xorValue = bits ^ mLastValue;
+    if (0 == xorValue)
+    {
+        write(0b0, 1);
+    }
+    else
+    {
+        auto leading = std::min(std::countl_zero(xorValue), 31);
+        auto trailing = std::countr_zero(xorValue);
+        if (mLeading >= 0 && leading >= mLeading && trailing >= mTrailing)
+        {
+            write(0b10, 2);
+            write(xorValue >> mTrailing, 64 - mLeading - mTrailing);
+        }
+        else
+        {
+            auto length = 64 - leading - trailing;
+            write(0b11, 2);
+            write(static_cast<uint64_t>(leading), 5);
+            // 长度64记为0
+            write(static_cast<uint64_t>(length & 63), 6);
+            write(xorValue >> trailing, length);
+            mLeading = leading;
+            mTrailing = trailing;
+        }
+    }
+    mLastTime = time;
+    mLastDelta = delta;
+    mLastValue = bits;
+    mCount++;
+    return true;
+}
+
+void HistoryBlock::decode(int64_t from, int64_t to, std::vector<HistoryPoint>& points) const
+{
+    if (0 == mCount)
+    {
+        return;
+    }
+    BitReader reader(mWords);
+    auto time = static_cast<int64_t>(reader.read(64));
+    auto bits = reader.read(64);
+    int64_t delta = 0;
+    int leading = 0;
+    int trailing = 0;
+    for (uint32_t i = 0; i < mCount; i++)
+    {
+        if (i > 0)
+        {
+            int64_t deltaOfDelta = 0;
+            if (reader.readBit())
+            {
+                if (!reader.readBit())
+                {
+                    deltaOfDelta = signExtend(reader.read(7), 7);
+                }
+                else if (!reader.readBit())
+                {
+                    deltaOfDelta = signExtend(reader.read(9), 9);
+                }
+                else if (!reader.readBit())
+                {
+                    deltaOfDelta = signExtend(reader.read(12), 12);
+                }
+                else
+                {
+                    deltaOfDelta = static_cast<int64_t>(reader.read(64));
+                }
+            }
+            delta += deltaOfDelta;
+            time += delta;
+            if (reader.readBit())
+            {
+                if (reader.readBit())
+                {
+                    leading = static_cast<int>(reader.read(5));
+                    auto length = static_cast<int>(reader.read(6));
+                    length = 0 == length ? 64 : length;
+                    trailing = 64 - leading - length;
+                }
+                bits ^= reader.read(64 - leading - trailing) << trailing;
+            }
+        }
+        if (time > to)
+        {
+            break;
+        }
+        if (time >= from)
+        {
+            points.push_back(HistoryPoint{time, bitsDouble(bits)});
+        }
+    }
+}
+
+int64_t HistoryBlock::startTime() const
+{
+    return mStartTime;
+}
+
+int64_t HistoryBlock::endTime() const
+{
+    return mLastTime;
+}
+
+uint32_t HistoryBlock::count() const
+{
+    return mCount;
+}
+
+size_t HistoryBlock::bytes() const
+{
+    return sizeof(HistoryBlock) + mWords.capacity() * sizeof(uint64_t);
+}
+
+void HistoryBlock::write(uint64_t value, int bits)
+{
+    if (0 == bits)
+    {
+        return;
+    }
+    if (bits < 64)
+    {
+        value &= (uint64_t(1) << bits) - 1;
+    }
+    auto word = mBitSize / 64;
+    auto offset = static_cast<int>(mBitSize % 64);
+    auto free = 64 - offset;
+    // 容量已预留，resize不会重新分配
+    mWords.resize((mBitSize + bits + 63) / 64);
+    if (bits <= free)
+    {
+        mWords[word] |= value << (free - bits);
+    }
+    else
+    {
+        mWords[word] |= value >> (bits - free);
+        mWords[word + 1] |= value << (64 - (bits - free));
+    }
+    mBitSize += bits;
+}
+
+History::History(size_t budget) : mBudget(budget)
+{
+}
+
+void History::append(const std::vector<Sample>& samples)
+{
+    std::scoped_lock lock(mLocker);
+    for (auto& sample : samples)
+    {
+        double value = 0;
+        if (!historyValue(sample.value, value))
+        {
+            continue;
+        }
+        auto time = sampleTimestamp(sample) / 1000;
+        if (sample.index >= mNodes.size())
+        {
+            mNodes.resize(sample.index + 1);
+        }
+        auto& node = mNodes[sample.index];
+        if (time <= node.lastTime)
+        {
+            continue;
+        }
+        if (node.blocks.empty())
+        {
+            node.blocks.push_back(std::make_unique<HistoryBlock>());
+            mBytes += node.blocks.back()->bytes();
+        }
+        if (!node.blocks.back()->append(time, value))
+        {
+            // 当前块写满，封存后写入新块
+            mSealed.push_back(sample.index);
+            node.blocks.push_back(std::make_unique<HistoryBlock>());
+            mBytes += node.blocks.back()->bytes();
+            node.blocks.back()->append(time, value);
+        }
+        node.lastTime = time;
+        mPoints++;
+    }
+    evict();
+}
+
+void History::query(uint32_t index, int64_t from, int64_t to, std::vector<HistoryPoint>& points)
+{
+    std::scoped_lock lock(mLocker);
+    if (index >= mNodes.size())
+    {
+        return;
+    }
+    for (auto& block : mNodes[index].blocks)
+    {
+        if (block->endTime() < from)
+        {
+            continue;
+        }
+        if (block->startTime() > to)
+        {
+            break;
+        }
+        block->decode(from, to, points);
+    }
+}
+
+size_t History::memoryBytes()
+{
+    std::scoped_lock lock(mLocker);
+    return mBytes;
+}
+
+uint64_t History::pointCount()
+{
+    std::scoped_lock lock(mLocker);
+    return mPoints;
+}
+
+void History::evict()
+{
+    // 各节点正在写入的块不淘汰，上限小于活动块总量时允许暂时超出
+    while (mBytes > mBudget && !mSealed.empty())
+    {
+        auto& blocks = mNodes[mSealed.front()].blocks;
+        mSealed.pop_front();
+        mBytes -= blocks.front()->bytes();
+        mPoints -= blocks.front()->count();
+        blocks.pop_front();
+    }
+}
@@ -0,0 +1,139 @@
+//
+// Created by cumtzt on 25-3-20.
+//
+#include "IOEngine.h"
+#include "Machine.h"
+#include "Logger.h"
+#include <algorithm>
+
+IOEngine::IOEngine(int threads, std::chrono::milliseconds tick) : mTick(std::max(tick, std::chrono::milliseconds(1)))
+{
+    threads = std::max(threads, 1);
+    for (int i = 0; i < threads; i++)
+    {
+        mWorkers.emplace_back(std::make_unique<Worker>());
+    }
+}
+
+IOEngine::~IOEngine()
+{
+    stop();
+}
+
+void IOEngine::attach(const std::shared_ptr<Machine>& machine)
+{
+    // 分配给当前负载最少的工作线程
+    auto iter = std::min_element(mWorkers.begin(), mWorkers.end(), [](auto& a, auto& b)
+    {
+        std::scoped_lock lock(a->locker, b->locker);
+        return a->machines.size() < b->machines.size();
+    });
+    auto& worker = **iter;
+    machine->setWakeup([this, target = machine.get()]() { wake(target); });
+    {
+        std::scoped_lock lock(worker.locker);
+        worker.machines.push_back(machine);
+        worker.woken = true;
+    }
+    worker.condition.notify_one();
+}
+
+void IOEngine::detach(const std::shared_ptr<Machine>& machine)
+{
+    machine->setWakeup(nullptr);
+    for (auto& worker : mWorkers)
+    {
+        std::scoped_lock lock(worker->locker);
+        std::erase(worker->machines, machine);
+    }
+}
+
+void IOEngine::wake(const Machine* machine)
+{
+    for (auto& worker : mWorkers)
+    {
+        std::unique_lock lock(worker->locker);
+        if (std::any_of(worker->machines.begin(), worker->machines.end(),
+                        [machine](auto& m) { return m.get() == machine; }))
+        {
+            worker->woken = true;
+            lock.unlock();
+            worker->condition.notify_one();
+            return;
+        }
+    }
+}
+
+void IOEngine::start()
+{
+    if (mRunning.exchange(true))
+    {
+        return;
+    }
+    for (auto& worker : mWorkers)
+    {
+        worker->thread = std::thread([this, &worker = *worker]() { run(worker); });
+    }
+    LogInfo("I/O引擎已启动，工作线程数：{}", mWorkers.size());
+}
+
+void IOEngine::stop()
+{
+    if (!mRunning.exchange(false))
+    {
+        return;
+    }
+    for (auto& worker : mWorkers)
+    {
+        {
+            std::scoped_lock lock(worker->locker);
+            worker->woken = true;
+        }
+        worker->condition.notify_one();
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+}
+
+int IOEngine::threads() const
+{
+    return static_cast<int>(mWorkers.size());
+}
+
+void IOEngine::run(Worker& worker)
+{
+    // 空闲时的最长等待时间，保证新增节点或配置变化能及时生效
+    constexpr auto idleWait = std::chrono::milliseconds(100);
+    std::vector<std::shared_ptr<Machine>> machines;
+    while (mRunning)
+    {
+        {
+            std::scoped_lock lock(worker.locker);
+            machines = worker.machines;
+        }
+        auto now = Machine::Clock::now();
+        auto next = now + idleWait;
+        for (auto& machine : machines)
+        {
+            try
+            {
+                auto deadline = machine->process(now);
+                if (machine->busy())
+                {
+                    deadline = std::min(deadline, now + mTick);
+                }
+                next = std::min(next, deadline);
+            }
+            catch (std::exception& e)
+            {
+                LogErr("{}", e.what());
+            }
+        }
+        machines.clear();
+        std::unique_lock lock(worker.locker);
+        worker.condition.wait_until(lock, next, [&worker, this]() { return worker.woken || !mRunning; });
+        worker.woken = false;
+    }
+}
@@ -3,12 +3,157 @@
 //
 #include "KafkaProducer.h"
 #include <yaml-cpp/yaml.h>
-#include <rapidjson/writer.h>
-#include <rapidjson/stringbuffer.h>
 #include "Logger.h"
 #include <QDateTime>
+#include <cppkafka/exceptions.h>
+#include <algorithm>
+#include <string_view>
+#include <fmt/format.h>
+#include <iterator>
 
-KafkaProducer::KafkaProducer(QObject *parent) : QObject(parent) {}
+namespace {
+    // 与rapidjson::Writer相同的转义规则：引号、反斜杠与控制字符
+    void appendJsonString(std::string& out, std::string_view text) {
+        static constexpr char hexDigits[] = "0123456789ABCDEF";
+        out.push_back('"');
+        size_t begin = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            auto c = static_cast<unsigned char>(text[i]);
+            if (c >= 0x20 && '"' != c && '\\' != c) {
+                continue;
+            }
+            out.append(text.data() + begin, i - begin);
+            begin = i + 1;
+            out.push_back('\\');
+            switch (c) {
+                case '"': out.push_back('"'); break;
+                case '\\': out.push_back('\\'); break;
+                case '\b': out.push_back('b'); break;
+                case '\f': out.push_back('f'); break;
+                case '\n': out.push_back('n'); break;
+                case '\r': out.push_back('r'); break;
+                case '\t': out.push_back('t'); break;
+                default:
+                    out.append("u00");
+                    out.push_back(hexDigits[c >> 4]);
+                    out.push_back(hexDigits[c & 0x0F]);
+                    break;
+            }
+        }
+        out.append(text.data() + begin, text.size() - begin);
+        out.push_back('"');
+    }
+}
+
+std::unique_ptr<KafkaBuffer> BufferPool::acquire() {
+    {
+        std::scoped_lock lock(mLocker);
+        if (!mFree.empty()) {
+            auto buffer = std::move(mFree.back());
+            mFree.pop_back();
+            mPooledBytes -= buffer->payload.capacity();
+            return buffer;
+        }
+        mAllocations++;
+    }
+    return std::make_unique<KafkaBuffer>();
+}
+
+void BufferPool::release(std::unique_ptr<KafkaBuffer> buffer) {
+    if (nullptr == buffer) {
+        return;
+    }
+    buffer->topic.clear();
+    buffer->key.clear();
+    buffer->payload.clear();
+    buffer->attempts = 0;
+    buffer->spoolId = 0;
+    buffer->dictionary = false;
+    std::scoped_lock lock(mLocker);
+    if (mPooledBytes + buffer->payload.capacity() > MaxPooledBytes) {
+        return;
+    }
+    mPooledBytes += buffer->payload.capacity();
+    mFree.push_back(std::move(buffer));
+}
+
+uint64_t BufferPool::allocations() {
+    std::scoped_lock lock(mLocker);
+    return mAllocations;
+}
+
+KafkaProducer::KafkaProducer(QObject *parent) : QObject(parent) {
+    // 定时器随对象移动到生产者线程，在该线程中启动
+    mpFlushTimer = new QTimer(this);
+    connect(mpFlushTimer, &QTimer::timeout, this, &KafkaProducer::onFlushTimeout);
+}
+
+KafkaProducer::~KafkaProducer() {
+    mPolling = false;
+    if (mPollThread.joinable()) {
+        mPollThread.join();
+    }
+    if (nullptr != mpProducer) {
+        try {
+            mpProducer->flush(std::chrono::seconds(5));
+        }
+        catch (std::exception& e) {
+            LogErr("Kafka消息清空失败：{}", e.what());
+        }
+        // 未投递的消息清出librdkafka，由投递报告取回缓冲后再销毁生产者
+        rd_kafka_purge(mpProducer->get_handle(), RD_KAFKA_PURGE_F_QUEUE | RD_KAFKA_PURGE_F_INFLIGHT);
+        mpProducer->poll(std::chrono::milliseconds(100));
+        mpProducer = nullptr;
+    }
+}
+
+std::map<std::string, TopicStatistics> KafkaProducer::statistics() {
+    std::scoped_lock lock(mQueueLocker);
+    return mStatistics;
+}
+
+std::pair<size_t, size_t> KafkaProducer::queueUsage() {
+    std::scoped_lock lock(mQueueLocker);
+    return {mPendingMessages.size(), mPendingBytes};
+}
+
+std::pair<size_t, uint64_t> KafkaProducer::spoolUsage() {
+    return {mSpool.diskBytes(), mSpool.evictedSegments()};
+}
+
+void KafkaProducer::createSampleRing(size_t capacity, OverflowPolicy policy) {
+    mpSampleRing = std::make_shared<SampleRing>(capacity, policy);
+    // 队列由空变为非空时投递一次事件，取出在生产者线程中进行
+    mpSampleRing->setNotify([this]() {
+        QMetaObject::invokeMethod(this, &KafkaProducer::drainRing, Qt::QueuedConnection);
+    });
+}
+
+std::shared_ptr<SampleRing> KafkaProducer::sampleRing() {
+    return mpSampleRing;
+}
+
+void KafkaProducer::drainRing() {
+    if (nullptr == mpSampleRing) {
+        return;
+    }
+    mpSampleRing->rearm();
+    for (size_t i = 0; i < mpSampleRing->capacity() && mpSampleRing->pop(mRingSlot); i++) {
+        onNewDatas(mRingSlot.topic, mRingSlot.code, mRingSlot.batch);
+    }
+    if (!mpSampleRing->empty()) {
+        QMetaObject::invokeMethod(this, &KafkaProducer::drainRing, Qt::QueuedConnection);
+    }
+}
+
+uint64_t KafkaProducer::bufferAllocations() {
+    return mBufferPool.allocations();
+}
+
+void KafkaProducer::setShard(int index, int count) {
+    mShardIndex = index;
+    mShardCount = std::max(count, 1);
+}
 
 void KafkaProducer::loadConfig(const std::string& configFile) {
     cppkafka::Configuration config;
@@ -24,16 +169,133 @@ void KafkaProducer::loadConfig(const std::string& configFile) {
 
         if (configNode["kafka_producer"]) {
             auto kafkaNode = configNode["kafka_producer"];
+            // 任意librdkafka配置项原样传入，如linger.ms、batch.size、compression.type、acks
+            if (kafkaNode["properties"] && kafkaNode["properties"].IsMap()) {
+                for (auto&& property : kafkaNode["properties"]) {
+                    auto key = property.first.as<std::string>();
+                    auto value = property.second.as<std::string>();
+                    try {
+                        config.set(key, value);
+                        LogInfo("Kafka配置项[{}={}]", key, value);
+                    }
+                    catch (std::exception& e) {
+                        LogErr("Kafka配置项[{}={}]无效：{}", key, value, e.what());
+                    }
+                }
+            }
+            // librdkafka自身队列由properties中的queue.buffering.max.messages/kbytes限制
+            if (kafkaNode["queue_max_bytes"]) {
+                mQueueMaxBytes = std::max<size_t>(kafkaNode["queue_max_bytes"].as<size_t>(), 1024);
+            }
+            if (kafkaNode["max_retries"]) {
+                mMaxRetries = kafkaNode["max_retries"].as<uint32_t>();
+            }
+            if (kafkaNode["time_format"]) {
+                auto format = kafkaNode["time_format"].as<std::string>();
+                if ("iso" == format) {
+                    mTimeFormat = TimeFormat::Iso;
+                } else if ("epoch_ms" == format) {
+                    mTimeFormat = TimeFormat::EpochMs;
+                } else if ("epoch_us" == format) {
+                    mTimeFormat = TimeFormat::EpochUs;
+                } else if ("legacy" != format) {
+                    LogWarn("不支持的时间格式[{}]，使用legacy", format);
+                }
+            }
+            if (kafkaNode["key"]) {
+                auto key = kafkaNode["key"].as<std::string>();
+                if ("machine" == key) {
+                    mMessageKey = MessageKey::Machine;
+                } else if ("node" == key) {
+                    mMessageKey = MessageKey::Node;
+                } else if ("none" != key) {
+                    LogWarn("不支持的Kafka消息键[{}]，不设置消息键", key);
+                }
+            }
+            config.set_delivery_report_callback([this](cppkafka::Producer&, const cppkafka::Message& message) {
+                onDelivery(message);
+            });
+            config.set_error_callback([this](cppkafka::KafkaHandleBase&, int error, const std::string& reason) {
+                if (RD_KAFKA_RESP_ERR__ALL_BROKERS_DOWN == error) {
+                    if (!mBrokerDown.exchange(true)) {
+                        LogWarn("Kafka代理全部不可用：{}", reason);
+                    }
+                    return;
+                }
+                LogErr("Kafka错误[{}]：{}", error, reason);
+            });
+            if (kafkaNode["spool"]) {
+                auto spoolNode = kafkaNode["spool"];
+                if (spoolNode["enabled"] && spoolNode["enabled"].as<bool>()) {
+                    auto dir = spoolNode["dir"] ? spoolNode["dir"].as<std::string>() : std::string("./spool");
+                    if (mShardCount > 1) {
+                        dir += "/" + std::to_string(mShardIndex);
+                    }
+                    auto segmentBytes = spoolNode["segment_bytes"] ? spoolNode["segment_bytes"].as<size_t>() : 16 * 1024 * 1024;
+                    auto maxBytes = spoolNode["max_bytes"] ? spoolNode["max_bytes"].as<size_t>() : size_t{1024} * 1024 * 1024;
+                    if (spoolNode["drain_rate"]) {
+                        mDrainRate = std::max(spoolNode["drain_rate"].as<int>(), 1);
+                    }
+                    mSpoolEnabled = mSpool.open(dir, segmentBytes, maxBytes);
+                    mLastDrain = std::chrono::steady_clock::now();
+                }
+            }
+            // 按topic选择消息格式
+            if (kafkaNode["topics"] && kafkaNode["topics"].IsMap()) {
+                for (auto&& item : kafkaNode["topics"]) {
+                    auto topic = item.first.as<std::string>();
+                    TopicConfig topicConfig;
+                    if (item.second["format"] && "binary" == item.second["format"].as<std::string>()) {
+                        topicConfig.format = MessageFormat::Binary;
+                    }
+                    topicConfig.dictionaryTopic = item.second["dictionary_topic"]
+                                                      ? item.second["dictionary_topic"].as<std::string>()
+                                                      : topic + "_dictionary";
+                    mTopicConfigs[topic] = topicConfig;
+                }
+            }
+            if (kafkaNode["dictionary_interval"]) {
+                mDictionaryInterval = std::chrono::seconds(std::max(kafkaNode["dictionary_interval"].as<int>(), 1));
+            }
+            if (kafkaNode["aggregation"]) {
+                auto aggregationNode = kafkaNode["aggregation"];
+                mAggregation = aggregationNode["enabled"] && aggregationNode["enabled"].as<bool>();
+                if (aggregationNode["max_bytes"]) {
+                    mAggregateMaxBytes = std::max<size_t>(aggregationNode["max_bytes"].as<size_t>(), 1024);
+                }
+                if (aggregationNode["max_delay"]) {
+                    mAggregateMaxDelay = std::chrono::milliseconds(std::max(aggregationNode["max_delay"].as<int>(), 1));
+                }
+            }
             if (kafkaNode["brokers"]){
                 auto brokers = kafkaNode["brokers"].as<std::string>();
                 config.set("metadata.broker.list", brokers);
-                mpProducer = std::make_shared<cppkafka::Producer>(config);
+                try {
+                    mpProducer = std::make_shared<cppkafka::Producer>(config);
+                    mPolling = true;
+                    mPollThread = std::thread([this]() {
+                        while (mPolling) {
+                            mpProducer->poll(std::chrono::milliseconds(100));
+                        }
+                    });
+                }
+                catch (std::exception& e) {
+                    LogErr("创建Kafka生产者失败：{}", e.what());
+                }
             }
         }
     }
+    // 暂存队列按固定间隔重试；聚合时检查间隔取最长等待的一部分，使实际等待不超过max_delay太多
+    auto interval = 100;
+    if (mAggregation) {
+        LogInfo("Kafka消息聚合已开启，单条上限{}字节，最长等待{}ms", mAggregateMaxBytes, mAggregateMaxDelay.count());
+        interval = static_cast<int>(std::clamp<int64_t>(mAggregateMaxDelay.count() / 4, 10, 100));
+    }
+    QMetaObject::invokeMethod(mpFlushTimer, [this, interval]() { mpFlushTimer->start(interval); },
+                              Qt::QueuedConnection);
 }
 
-void KafkaProducer::onNewDatas(const std::string& dist,const std::string& source, const std::vector<std::pair<std::string,std::string>>& datas) {
+void KafkaProducer::onNewDatas(const std::string& dist,const std::string& source, const SampleBatch& batch) {
     if (nullptr == mpProducer) {
         LogWarn("{}","Kafka生产者为nullptr！");
         return;
@@ -47,44 +309,477 @@ void KafkaProducer::onNewDatas(const std::string& dist,const std::string& source
         LogWarn("{}","电站code为空！");
         return;
     }
-    if (datas.empty())
+    if (batch.samples.empty() || nullptr == batch.dictionary)
     {
         LogWarn("{}","数据为空！");
         return;
     }
-    cppkafka::MessageBuilder builder(dist);
-    std::string message;
-    try {
-        rapidjson::StringBuffer buf;
-        rapidjson::Writer writer(buf);
-        writer.StartArray();
-        writer.StartObject();
-        writer.Key("code");
-        writer.String((mStationCode+":"+source).c_str());
-        auto collectTime = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz").toStdString();
-        writer.Key("collectTime");
-        writer.String(collectTime.c_str());
-        writer.Key("params");
-        writer.StartArray();
-        for (auto data: datas) {
-            writer.StartObject();
-            writer.Key("code");writer.String(data.first.c_str());
-            writer.Key("val");writer.String(data.second.c_str());
-            writer.EndObject();
-        }
-        writer.EndArray();
-        writer.EndObject();
-        writer.EndArray();
-        message = buf.GetString();
-    }
-    catch (std::exception& e) {
-        LogErr("json数据序列化失败！: {}",e.what());
-        return;
-    }
-    if (message.empty()) {
-        LogWarn("json数据为空！");
-        return;
-    }
-    builder.payload({message.c_str(), message.size()});
-    mpProducer->produce(builder);
+    const auto& config = topicConfig(dist);
+    auto& prefix = sourcePrefix(source);
+    const bool json = MessageFormat::Json == config.format;
+    const auto& dictionary = *batch.dictionary;
+    // 采集时间在读取返回时记录，未记录时才使用当前时间
+    const auto collectTime = 0 != batch.collectTime ? batch.collectTime : currentUnixMicroseconds();
+    if (!json) {
+        publishDictionary(config.dictionaryTopic, prefix.dictionaryId, prefix.source, dictionary);
+    }
+    if (MessageKey::Node != mMessageKey) {
+        static const std::string noKey;
+        publish(dist, MessageKey::Machine == mMessageKey ? prefix.source : noKey, prefix, dictionary, batch.samples,
+                collectTime, json);
+        return;
+    }
+    // 节点字典只追加，按键随字典增长补齐
+    while (prefix.nodeKeys.size() < dictionary.size()) {
+        prefix.nodeKeys.push_back(prefix.source + ":" + dictionary[prefix.nodeKeys.size()]);
+    }
+    for (const auto& sample : batch.samples) {
+        if (sample.index < dictionary.size()) {
+            publish(dist, prefix.nodeKeys[sample.index], prefix, dictionary, {&sample, 1}, collectTime, json);
+        }
+    }
+}
+
+void KafkaProducer::publish(const std::string& topic, const std::string& key, const SourcePrefix& prefix,
+                            const NodeDictionary& dictionary, std::span<const Sample> samples, int64_t collectTime,
+                            bool json) {
+    if (mAggregation) {
+        append(topic, key, prefix, dictionary, samples, collectTime, json);
+        return;
+    }
+    auto buffer = mBufferPool.acquire();
+    buffer->topic = topic;
+    buffer->key = key;
+    if (json) {
+        buffer->payload.push_back('[');
+    }
+    encode(prefix, dictionary, samples, collectTime, json, buffer->payload);
+    if (json) {
+        buffer->payload.push_back(']');
+    }
+    produce(std::move(buffer));
+}
+
+SourcePrefix& KafkaProducer::sourcePrefix(const std::string& source) {
+    auto iter = mSourcePrefixes.find(source);
+    if (iter != mSourcePrefixes.end()) {
+        return iter->second;
+    }
+    SourcePrefix prefix;
+    prefix.source = mStationCode + ":" + source;
+    prefix.dictionaryId = binaryDictionaryId(prefix.source);
+    prefix.json = "{\"code\":";
+    appendJsonString(prefix.json, prefix.source);
+    prefix.json.append(",\"collectTime\":");
+    return mSourcePrefixes.emplace(source, std::move(prefix)).first->second;
+}
+
+const TopicConfig& KafkaProducer::topicConfig(const std::string& topic) {
+    static const TopicConfig defaultConfig;
+    auto iter = mTopicConfigs.find(topic);
+    return iter == mTopicConfigs.end() ? defaultConfig : iter->second;
+}
+
+void KafkaProducer::publishDictionary(const std::string& topic, uint32_t id, const std::string& source,
+                                      const NodeDictionary& dictionary) {
+    auto now = std::chrono::steady_clock::now();
+    if (mDictionaryLost.exchange(false)) {
+        mDictionaries.clear();
+    }
+    auto& published = mDictionaries[topic][id];
+    if (published.size == dictionary.size() && now - published.time < mDictionaryInterval) {
+        return;
+    }
+    // 以字典ID为键，字典topic可开启日志压缩只保留最新字典
+    auto buffer = mBufferPool.acquire();
+    buffer->topic = topic;
+    buffer->key = std::to_string(id);
+    buffer->dictionary = true;
+    buffer->payload = encodeBinaryDictionary(id, source, dictionary);
+    if (tryProduce(buffer)) {
+        published = {dictionary.size(), now};
+        return;
+    }
+    LogWarn("Kafka队列已满，字典[{}]在下个采集周期重发", topic);
+    mBufferPool.release(std::move(buffer));
+}
+
+void KafkaProducer::onFlushTimeout() {
+    drainRing();
+    if (nullptr == mpProducer) {
+        return;
+    }
+    drain();
+    drainSpool();
+    auto now = std::chrono::steady_clock::now();
+    for (auto& [topic, messages] : mAggregates) {
+        for (auto& [key, message] : messages) {
+            if (message.cycles > 0 && now - message.firstTime >= mAggregateMaxDelay) {
+                flush(message);
+            }
+        }
+    }
+    updateBackpressure();
+}
+
+void KafkaProducer::encode(const SourcePrefix& prefix, const NodeDictionary& dictionary,
+                           std::span<const Sample> samples, int64_t collectTime, bool json, std::string& out) {
+    if (json) {
+        serialize(prefix, dictionary, samples, collectTime, out);
+        return;
+    }
+    encodeBinaryRecord(prefix.dictionaryId, static_cast<uint32_t>(dictionary.size()), collectTime, samples, out);
+}
+
+void KafkaProducer::serialize(const SourcePrefix& prefix, const NodeDictionary& dictionary,
+                              std::span<const Sample> samples, int64_t collectTime, std::string& out) {
+    // 直接写入发送缓冲，输出与rapidjson紧凑格式一致
+    out.append(prefix.json);
+    appendTime(out, collectTime);
+    out.append(",\"params\":[");
+    bool first = true;
+    for (const auto& sample : samples) {
+        if (sample.index >= dictionary.size()) {
+            continue;
+        }
+        out.append(first ? "{\"code\":" : ",{\"code\":");
+        first = false;
+        appendJsonString(out, dictionary[sample.index]);
+        out.append(",\"val\":");
+        if (auto text = std::get_if<std::string>(&sample.value)) {
+            appendJsonString(out, *text);
+        } else {
+            out.push_back('"');
+            appendSampleValue(out, sample.value);
+            out.push_back('"');
+        }
+        // 服务器未提供源时间戳时使用采集时间
+        out.append(",\"time\":");
+        appendTime(out, sampleTimestamp(sample));
+        fmt::format_to(std::back_inserter(out), ",\"status\":{}}}", sample.status);
+    }
+    out.append("]}");
+}
+
+void KafkaProducer::appendTime(std::string& out, int64_t microseconds) {
+    if (TimeFormat::EpochUs == mTimeFormat) {
+        fmt::format_to(std::back_inserter(out), "{}", microseconds);
+        return;
+    }
+    if (TimeFormat::EpochMs == mTimeFormat) {
+        fmt::format_to(std::back_inserter(out), "{}", microseconds / 1000);
+        return;
+    }
+    // 时区偏移均为整分钟，同一分钟内日期部分不变
+    auto minute = microseconds / 60000000;
+    if (minute != mCachedMinute) {
+        mCachedMinute = minute;
+        auto time = QDateTime::fromMSecsSinceEpoch(minute * 60000);
+        mCachedDate = (TimeFormat::Iso == mTimeFormat ? time.toUTC().toString("yyyy-MM-dd'T'hh:mm:")
+                                                      : time.toString("yyyy-MM-dd hh:mm:")).toStdString();
+    }
+    out.push_back('"');
+    out.append(mCachedDate);
+    auto fraction = static_cast<int>(microseconds % 60000000);
+    char digits[] = "00.000000";
+    digits[0] = static_cast<char>('0' + fraction / 10000000);
+    digits[1] = static_cast<char>('0' + fraction / 1000000 % 10);
+    for (int i = 8, rest = fraction % 1000000; i >= 3; i--, rest /= 10) {
+        digits[i] = static_cast<char>('0' + rest % 10);
+    }
+    // legacy精确到毫秒，iso精确到微秒
+    if (TimeFormat::Iso == mTimeFormat) {
+        out.append(digits, 9);
+        out.push_back('Z');
+    } else {
+        out.append(digits, 6);
+    }
+    out.push_back('"');
+}
+
+void KafkaProducer::append(const std::string& topic, const std::string& key, const SourcePrefix& prefix,
+                           const NodeDictionary& dictionary, std::span<const Sample> samples, int64_t collectTime,
+                           bool json) {
+    auto& message = mAggregates[topic][key];
+    if (nullptr == message.buffer) {
+        message.buffer = mBufferPool.acquire();
+        message.buffer->topic = topic;
+        message.buffer->key = key;
+    }
+    const auto mark = message.buffer->payload.size();
+    if (json) {
+        message.buffer->payload.push_back(0 == message.cycles ? '[' : ',');
+    }
+    encode(prefix, dictionary, samples, collectTime, json, message.buffer->payload);
+    // 加入后超过上限时本周期移入新缓冲，先发送已聚合的部分；单个周期超过上限时单独发送
+    if (message.cycles > 0 && message.buffer->payload.size() + 1 > mAggregateMaxBytes) {
+        auto next = mBufferPool.acquire();
+        next->topic = topic;
+        next->key = key;
+        if (json) {
+            next->payload.push_back('[');
+        }
+        next->payload.append(message.buffer->payload, json ? mark + 1 : mark, std::string::npos);
+        message.buffer->payload.resize(mark);
+        flush(message);
+        message.buffer = std::move(next);
+    }
+    if (0 == message.cycles) {
+        message.json = json;
+        message.firstTime = std::chrono::steady_clock::now();
+    }
+    message.cycles++;
+    if (message.buffer->payload.size() + 1 >= mAggregateMaxBytes) {
+        flush(message);
+    }
+}
+
+void KafkaProducer::flush(AggregateMessage& message) {
+    if (0 == message.cycles || nullptr == message.buffer) {
+        return;
+    }
+    if (message.json) {
+        message.buffer->payload.push_back(']');
+    }
+    produce(std::move(message.buffer));
+    message.cycles = 0;
+}
+
+void KafkaProducer::produce(std::unique_ptr<KafkaBuffer> buffer) {
+    {
+        // 暂存队列非空时新消息排在其后，保持发送顺序
+        std::scoped_lock lock(mQueueLocker);
+        if (!mPendingMessages.empty()) {
+            enqueue(std::move(buffer));
+            return;
+        }
+        if (mSpoolEnabled && mBrokerDown && mpProducer->get_out_queue_length() > 0) {
+            spool(*buffer);
+            mBufferPool.release(std::move(buffer));
+            return;
+        }
+    }
+    if (!tryProduce(buffer)) {
+        std::scoped_lock lock(mQueueLocker);
+        enqueue(std::move(buffer));
+    }
+    updateBackpressure();
+}
+
+bool KafkaProducer::tryProduce(std::unique_ptr<KafkaBuffer>& buffer) {
+    // 投递报告在轮询线程中取回缓冲，持锁发送保证成功后缓冲不会在统计前被回收
+    std::scoped_lock lock(mQueueLocker);
+    auto& key = buffer->key;
+    auto& payload = buffer->payload;
+    // 不设置RD_KAFKA_MSG_F_COPY，librdkafka直接引用缓冲内容
+    auto error = rd_kafka_producev(mpProducer->get_handle(),
+                                   RD_KAFKA_V_TOPIC(buffer->topic.c_str()),
+                                   RD_KAFKA_V_MSGFLAGS(0),
+                                   RD_KAFKA_V_VALUE(payload.data(), payload.size()),
+                                   RD_KAFKA_V_KEY(key.empty() ? nullptr : key.data(), key.size()),
+                                   RD_KAFKA_V_OPAQUE(buffer.get()),
+                                   RD_KAFKA_V_END);
+    if (RD_KAFKA_RESP_ERR__QUEUE_FULL == error) {
+        return false;
+    }
+    if (RD_KAFKA_RESP_ERR_NO_ERROR != error) {
+        LogErr("Kafka消息发送失败[{}]：{}", buffer->topic, rd_kafka_err2str(error));
+        if (0 != buffer->spoolId) {
+            // 重发记录仍在落盘队列中，稍后重新发送
+            settleSpool(buffer->spoolId, false);
+        } else {
+            drop(*buffer);
+        }
+        mBufferPool.release(std::move(buffer));
+        return true;
+    }
+    mStatistics[buffer->topic].produced++;
+    buffer.release();
+    return true;
+}
+
+void KafkaProducer::enqueue(std::unique_ptr<KafkaBuffer> buffer) {
+    // 持有mQueueLocker时调用；超出内存上限时最旧的消息转入落盘队列，未开启落盘时丢弃
+    mPendingBytes += buffer->payload.size();
+    mPendingMessages.push_back(std::move(buffer));
+    while (mPendingBytes > mQueueMaxBytes && mPendingMessages.size() > 1) {
+        auto oldest = std::move(mPendingMessages.front());
+        mPendingMessages.pop_front();
+        mPendingBytes -= oldest->payload.size();
+        if (!mSpoolEnabled) {
+            LogWarn("Kafka暂存队列超出{}字节，丢弃topic[{}]最旧消息", mQueueMaxBytes, oldest->topic);
+        }
+        spool(*oldest);
+        mBufferPool.release(std::move(oldest));
+    }
+}
+
+void KafkaProducer::drain() {
+    while (true) {
+        std::unique_ptr<KafkaBuffer> buffer;
+        {
+            std::scoped_lock lock(mQueueLocker);
+            if (mPendingMessages.empty()) {
+                return;
+            }
+            buffer = std::move(mPendingMessages.front());
+            mPendingMessages.pop_front();
+            mPendingBytes -= buffer->payload.size();
+        }
+        if (!tryProduce(buffer)) {
+            // 仍然已满，放回队首等待下次重试
+            std::scoped_lock lock(mQueueLocker);
+            mPendingBytes += buffer->payload.size();
+            mPendingMessages.push_front(std::move(buffer));
+            return;
+        }
+    }
+}
+
+void KafkaProducer::drainSpool() {
+    if (!mSpoolEnabled) {
+        return;
+    }
+    // 令牌桶限速，积累上限为一秒的配额
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration<double>(now - mLastDrain).count();
+    mLastDrain = now;
+    mDrainBudget = std::min(mDrainBudget + elapsed * mDrainRate, static_cast<double>(mDrainRate));
+    if (mBrokerDown) {
+        return;
+    }
+    {
+        // 有记录投递失败时停止重发，等待退回后按原顺序重新发送
+        std::scoped_lock lock(mQueueLocker);
+        if (!mPendingMessages.empty() ||
+            mDrainWindow.end() != std::ranges::find(mDrainWindow, DrainState::Failed)) {
+            return;
+        }
+    }
+    auto buffer = mBufferPool.acquire();
+    while (mDrainBudget >= 1 && mSpool.peek(buffer->topic, buffer->key, buffer->payload)) {
+        {
+            // 先登记再发送，投递报告不会早于登记到达
+            std::scoped_lock lock(mQueueLocker);
+            if (mDrainWindow.end() != std::ranges::find(mDrainWindow, DrainState::Failed)) {
+                break;
+            }
+            buffer->spoolId = mSpool.advance();
+            if (mDrainWindow.empty()) {
+                mDrainBase = buffer->spoolId;
+            }
+            mDrainWindow.push_back(DrainState::Pending);
+        }
+        if (!tryProduce(buffer)) {
+            std::scoped_lock lock(mQueueLocker);
+            settleSpool(buffer->spoolId, false);
+            break;
+        }
+        mDrainBudget -= 1;
+        buffer = mBufferPool.acquire();
+    }
+    mBufferPool.release(std::move(buffer));
+}
+
+void KafkaProducer::settleSpool(uint64_t id, bool delivered) {
+    // 退回之前发出的记录序号小于mDrainBase，直接忽略
+    if (id < mDrainBase || id - mDrainBase >= mDrainWindow.size()) {
+        return;
+    }
+    mDrainWindow[id - mDrainBase] = delivered ? DrainState::Delivered : DrainState::Failed;
+    while (!mDrainWindow.empty() && DrainState::Delivered == mDrainWindow.front()) {
+        mSpool.commit(mDrainBase);
+        mDrainWindow.pop_front();
+        mDrainBase++;
+    }
+    if (mDrainWindow.empty() || mDrainWindow.end() != std::ranges::find(mDrainWindow, DrainState::Pending)) {
+        return;
+    }
+    // 队首记录失败且没有在途记录：其后已投递成功的记录一并重发，保证同一键的顺序
+    mSpool.rewind();
+    mDrainBase += mDrainWindow.size();
+    mDrainWindow.clear();
+}
+
+void KafkaProducer::spool(const KafkaBuffer& buffer) {
+    if (mSpoolEnabled && mSpool.append(buffer.topic, buffer.key, buffer.payload)) {
+        mStatistics[buffer.topic].spooled++;
+    } else {
+        drop(buffer);
+    }
+}
+
+void KafkaProducer::drop(const KafkaBuffer& buffer) {
+    mStatistics[buffer.topic].dropped++;
+    if (buffer.dictionary) {
+        mDictionaryLost = true;
+    }
+}
+
+void KafkaProducer::onDelivery(const cppkafka::Message& message) {
+    // 在轮询线程中回调，取回发送时交给librdkafka的缓冲
+    std::unique_ptr<KafkaBuffer> buffer(static_cast<KafkaBuffer*>(message.get_user_data()));
+    if (nullptr == buffer) {
+        return;
+    }
+    std::scoped_lock lock(mQueueLocker);
+    auto& statistics = mStatistics[buffer->topic];
+    if (!message.get_error()) {
+        statistics.delivered++;
+        if (mBrokerDown.exchange(false)) {
+            LogInfo("Kafka代理恢复，开始重发落盘队列");
+        }
+        if (0 != buffer->spoolId) {
+            settleSpool(buffer->spoolId, true);
+        }
+        mBufferPool.release(std::move(buffer));
+        return;
+    }
+    if (RD_KAFKA_RESP_ERR__MSG_TIMED_OUT == message.get_error().get_error()) {
+        mBrokerDown = true;
+    }
+    if (0 != buffer->spoolId) {
+        // 重发记录确认前一直保留在落盘队列中，不再重复写入
+        LogWarn("Kafka落盘记录重发失败[{}]，稍后按原顺序重新发送：{}", buffer->topic,
+                message.get_error().to_string());
+        statistics.retried++;
+        settleSpool(buffer->spoolId, false);
+        mBufferPool.release(std::move(buffer));
+        return;
+    }
+    if (mSpoolEnabled && (mBrokerDown || buffer->attempts >= mMaxRetries)) {
+        spool(*buffer);
+        mBufferPool.release(std::move(buffer));
+        return;
+    }
+    if (buffer->attempts >= mMaxRetries) {
+        LogErr("Kafka消息投递失败[{}]，已重试{}次，丢弃：{}", buffer->topic, buffer->attempts,
+               message.get_error().to_string());
+        drop(*buffer);
+        mBufferPool.release(std::move(buffer));
+        return;
+    }
+    LogWarn("Kafka消息投递失败[{}]，重新排队：{}", buffer->topic, message.get_error().to_string());
+    statistics.retried++;
+    buffer->attempts++;
+    enqueue(std::move(buffer));
+}
+
+void KafkaProducer::updateBackpressure() {
+    bool active = false;
+    {
+        // 暂存队列非空说明librdkafka队列已满或有消息等待重投
+        std::scoped_lock lock(mQueueLocker);
+        active = !mPendingMessages.empty();
+        if (active == mBackpressure) {
+            return;
+        }
+        mBackpressure = active;
+    }
+    if (active) {
+        LogWarn("Kafka发送积压，通知采集端合并上报");
+    } else {
+        LogInfo("Kafka发送积压解除");
+    }
+    emit backpressureChanged(active);
 }
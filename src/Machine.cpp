@@ -10,13 +10,19 @@
 #include <QMetaType>
 #include "QDebug"
 #include <QString>
-#include <QTimer>
 #include <mutex>
+#include <algorithm>
+#include <optional>
+#include <map>
 
 IMPLEMENT_EXCEPTION(OPCServerNotConnectException, RuntimeException, "未连接到OPC服务")
 IMPLEMENT_EXCEPTION(OPCNodeCodeFormatErrorException, RuntimeException, "OPC节点Code格式解析错误")
 IMPLEMENT_EXCEPTION(OPCNodeNotExistException, RuntimeException, "OPC节点不存在")
 IMPLEMENT_EXCEPTION(OPCNodeTypeNotSupportException, RuntimeException, "OPC节点格式不被支持")
+IMPLEMENT_EXCEPTION(OPCCommandTimeoutException, RuntimeException, "OPC指令执行超时")
+IMPLEMENT_EXCEPTION(OPCWriteFailedException, RuntimeException, "OPC节点写入失败")
+IMPLEMENT_EXCEPTION(OPCReadFailedException, RuntimeException, "OPC节点读取失败")
+IMPLEMENT_EXCEPTION(OPCHistoryDisabledException, RuntimeException, "OPC节点历史记录未启用")
 
 // 辅助函数：去除字符串两端的空白字符
 std::string trim(const std::string& s)
@@ -44,25 +50,242 @@ bool string_to_bool(const std::string& s)
     throw std::invalid_argument("Invalid boolean string: " + s);
 }
 
-Machine::Machine(QObject* parent) : QThread(parent)
+// 解析"ns:id"格式的节点Code
+opcua::NodeId parseNodeCode(const std::string& nodeCode)
+{
+    auto index = nodeCode.find_first_of(':');
+    if (index == std::string::npos)
+    {
+        OPCNodeCodeFormatErrorException e(fmt::format("解析NodeCode[{}]失败", nodeCode));
+        e.rethrow();
+    }
+    try
+    {
+        return {static_cast<uint16_t>(std::stoi(nodeCode.substr(0, index))),
+                static_cast<uint32_t>(std::stoul(nodeCode.substr(index + 1)))};
+    }
+    catch (std::exception&)
+    {
+        OPCNodeCodeFormatErrorException e(fmt::format("解析NodeCode[{}]失败", nodeCode));
+        e.rethrow();
+    }
+    return {};
+}
+
+// 将OPC变量格式化为类型名称与字符串值，不支持的类型返回false
+bool formatVariant(const opcua::Variant& uaValue, std::string& type, std::string& value)
+{
+    if (uaValue.isEmpty() || nullptr == uaValue.type())
+    {
+        LogErr("OPC变量为空!");
+        return false;
+    }
+    switch (uint32_t typeKind = uaValue.type()->typeKind)
+    {
+    case UA_DATATYPEKIND_BOOLEAN:
+        type = "bool";
+        value = uaValue.to<bool>() ? "1" : "0";
+        break;
+    case UA_DATATYPEKIND_SBYTE:
+        type = "int8_t";
+        value = QString::number(uaValue.to<int8_t>()).toStdString();
+        break;
+    case UA_DATATYPEKIND_BYTE:
+        type = "uint8_t";
+        value = QString::number(uaValue.to<uint8_t>()).toStdString();
+        break;
+    case UA_DATATYPEKIND_INT16:
+        type = "int16_t";
+        value = QString::number(uaValue.to<int16_t>()).toStdString();
+        break;
+    case UA_DATATYPEKIND_UINT16:
+        type = "uint16_t";
+        value = QString::number(uaValue.to<uint16_t>()).toStdString();
+        break;
+    case UA_DATATYPEKIND_INT32:
+        type = "int32_t";
+        value = QString::number(uaValue.to<int>()).toStdString();
+        break;
+    case UA_DATATYPEKIND_UINT32:
+        type = "uint32_t";
+        value = QString::number(uaValue.to<uint32_t>()).toStdString();
+        break;
+    case UA_DATATYPEKIND_INT64:
+        type = "int64_t";
+        value = QString::number(uaValue.to<int64_t>()).toStdString();
+        break;
+    case UA_DATATYPEKIND_UINT64:
+        type = "uint64_t";
+        value = QString::number(uaValue.to<uint64_t>()).toStdString();
+        break;
+    case UA_DATATYPEKIND_FLOAT:
+        type = "float";
+        value = QString::number(uaValue.to<float>()).toStdString();
+        break;
+    case UA_DATATYPEKIND_DOUBLE:
+        type = "double";
+        value = QString::number(uaValue.to<double>()).toStdString();
+        break;
+    case UA_DATATYPEKIND_STRING:
+        type = "string";
+        value = uaValue.to<std::string>();
+        break;
+    default:
+        LogErr("不支持的数据类型: {}!", typeKind);
+        return false;
+    }
+    return true;
+}
+
+// 按节点数据类型将字符串转换为OPC变量，不支持的类型返回false
+bool toVariant(uint32_t typeKind, const std::string& value, opcua::Variant& variant)
+{
+    switch (typeKind)
+    {
+    case UA_DATATYPEKIND_BOOLEAN:
+        variant = opcua::Variant(string_to_bool(value));
+        break;
+    case UA_DATATYPEKIND_SBYTE:
+        variant = opcua::Variant(static_cast<int8_t>(QString::fromStdString(value).toInt()));
+        break;
+    case UA_DATATYPEKIND_BYTE:
+        variant = opcua::Variant(static_cast<uint8_t>(QString::fromStdString(value).toInt()));
+        break;
+    case UA_DATATYPEKIND_INT16:
+        variant = opcua::Variant(QString::fromStdString(value).toShort());
+        break;
+    case UA_DATATYPEKIND_UINT16:
+        variant = opcua::Variant(QString::fromStdString(value).toUShort());
+        break;
+    case UA_DATATYPEKIND_INT32:
+        variant = opcua::Variant(static_cast<int32_t>(QString::fromStdString(value).toInt()));
+        break;
+    case UA_DATATYPEKIND_UINT32:
+        variant = opcua::Variant(static_cast<uint32_t>(QString::fromStdString(value).toUInt()));
+        break;
+    case UA_DATATYPEKIND_INT64:
+        variant = opcua::Variant(static_cast<int64_t>(QString::fromStdString(value).toLongLong()));
+        break;
+    case UA_DATATYPEKIND_UINT64:
+        variant = opcua::Variant(static_cast<uint64_t>(QString::fromStdString(value).toULongLong()));
+        break;
+    case UA_DATATYPEKIND_FLOAT:
+        variant = opcua::Variant(QString::fromStdString(value).toFloat());
+        break;
+    case UA_DATATYPEKIND_DOUBLE:
+        variant = opcua::Variant(QString::fromStdString(value).toDouble());
+        break;
+    case UA_DATATYPEKIND_STRING:
+        variant = opcua::Variant(value);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+// OPC UA时间(1601纪元，100ns)转换为Unix纪元微秒
+int64_t toUnixMicroseconds(const opcua::DateTime& dateTime)
+{
+    return (dateTime.get() - UA_DATETIME_UNIX_EPOCH) / UA_DATETIME_USEC;
+}
+
+// 将DataValue转换为保持原生类型的采集样本，不支持的类型返回false
+bool toSample(const opcua::DataValue& dataValue, int64_t acquireTime, Sample& sample)
+{
+    const auto& uaValue = dataValue.value();
+    if (uaValue.isEmpty() || nullptr == uaValue.type())
+    {
+        return false;
+    }
+    switch (uaValue.type()->typeKind)
+    {
+    case UA_DATATYPEKIND_BOOLEAN:
+        sample.value = uaValue.to<bool>();
+        break;
+    case UA_DATATYPEKIND_SBYTE:
+        sample.value = uaValue.to<int8_t>();
+        break;
+    case UA_DATATYPEKIND_BYTE:
+        sample.value = uaValue.to<uint8_t>();
+        break;
+    case UA_DATATYPEKIND_INT16:
+        sample.value = uaValue.to<int16_t>();
+        break;
+    case UA_DATATYPEKIND_UINT16:
+        sample.value = uaValue.to<uint16_t>();
+        break;
+    case UA_DATATYPEKIND_INT32:
+        sample.value = uaValue.to<int32_t>();
+        break;
+    case UA_DATATYPEKIND_UINT32:
+        sample.value = uaValue.to<uint32_t>();
+        break;
+    case UA_DATATYPEKIND_INT64:
+        sample.value = uaValue.to<int64_t>();
+        break;
+    case UA_DATATYPEKIND_UINT64:
+        sample.value = uaValue.to<uint64_t>();
+        break;
+    case UA_DATATYPEKIND_FLOAT:
+        sample.value = uaValue.to<float>();
+        break;
+    case UA_DATATYPEKIND_DOUBLE:
+        sample.value = uaValue.to<double>();
+        break;
+    case UA_DATATYPEKIND_STRING:
+        sample.value = uaValue.to<std::string>();
+        break;
+    default:
+        LogErr("不支持的数据类型: {}!", uaValue.type()->typeKind);
+        return false;
+    }
+    sample.status = dataValue.hasStatus() ? dataValue.status().get() : UA_STATUSCODE_GOOD;
+    sample.sourceTime = dataValue.hasSourceTimestamp() ? toUnixMicroseconds(dataValue.sourceTimestamp()) : 0;
+    sample.serverTime = dataValue.hasServerTimestamp() ? toUnixMicroseconds(dataValue.serverTimestamp()) : 0;
+    sample.acquireTime = acquireTime;
+    return true;
+}
+
+int64_t latestAcquireTime(const std::vector<Sample>& samples)
+{
+    int64_t latest = 0;
+    for (const auto& sample : samples)
+    {
+        latest = std::max(latest, sample.acquireTime);
+    }
+    return latest;
+}
+
+const char* connectionStateName(ConnectionState state)
+{
+    switch (state)
+    {
+    case ConnectionState::Connecting:
+        return "connecting";
+    case ConnectionState::Reactivating:
+        return "reactivating";
+    case ConnectionState::Connected:
+        return "connected";
+    default:
+        return "disconnected";
+    }
+}
+
+Machine::Machine(QObject* parent) : QObject(parent)
 {
     opcua::ClientConfig config;
     config.setTimeout(500);
     mpClient = std::make_unique<opcua::Client>(std::move(config));
-    mpReconnectTimer = new QTimer(this);
-    mpReconnectTimer->setTimerType(Qt::VeryCoarseTimer);
-    mpReconnectTimer->setInterval(1000);
-    connect(mpReconnectTimer, &QTimer::timeout, this, &Machine::connectServer);
 }
 
 Machine::~Machine()
 {
     std::scoped_lock lock(mClientLocker);
-    mpReconnectTimer->stop();
-    if (mpClient->isConnected())
-    {
-        mpClient->disconnect();
-    }
+    mStarted = false;
+    // 断开时在途请求的回调以BadShutdown完成，需在成员析构前执行
+    mpClient->disconnect();
+    resetSession();
 }
 
 void Machine::setCode(const std::string& code)
@@ -88,32 +311,149 @@ void Machine::setUrl(const std::string& url)
     mUrl = url;
 }
 
-void Machine::collectNode(const std::string& node)
+void Machine::addScanGroup(const std::string& name, int interval)
 {
-    std::scoped_lock lock(mClientLocker);
-    mNodeCodes.insert(node);
+    updateNodeSet([&](NodeSet& nodeSet)
+    {
+        auto& group = nodeSet.groups[name];
+        group.name = name;
+        group.interval = std::chrono::milliseconds(interval);
+    });
+}
+
+void Machine::collectNode(const std::string& node, const std::string& group)
+{
+    updateNodeSet([&](NodeSet& nodeSet)
+    {
+        // 一个节点只属于一个扫描组，重复添加时移动到新组
+        for (auto& [name, scanGroup] : nodeSet.groups)
+        {
+            scanGroup.nodes.erase(node);
+        }
+        auto groupName = group.empty() ? DefaultScanGroup : group;
+        auto& scanGroup = nodeSet.groups[groupName];
+        scanGroup.name = groupName;
+        scanGroup.nodes.insert(node);
+        nodeSet.nodes.insert(node);
+    });
 }
 
 void Machine::removeCollectingNode(const std::string& node)
 {
-    std::scoped_lock lock(mClientLocker);
-    auto iter = mNodeCodes.find(node);
-    if (iter != mNodeCodes.end())
+    updateNodeSet([&](NodeSet& nodeSet)
+    {
+        nodeSet.nodes.erase(node);
+        for (auto& [name, scanGroup] : nodeSet.groups)
+        {
+            scanGroup.nodes.erase(node);
+        }
+    });
+}
+
+void Machine::updateNodeSet(const std::function<void(NodeSet&)>& modifier)
+{
+    std::scoped_lock lock(mNodeSetLocker);
+    auto current = mpNodeSet.load();
+    auto nodeSet = current ? std::make_shared<NodeSet>(*current) : std::make_shared<NodeSet>();
+    modifier(*nodeSet);
+    std::shared_ptr<NodeDictionary> dictionary = nullptr;
+    for (auto&& node : nodeSet->nodes)
+    {
+        if (nodeSet->indices.contains(node))
+        {
+            continue;
+        }
+        if (nullptr == dictionary)
+        {
+            dictionary = nodeSet->dictionary ? std::make_shared<NodeDictionary>(*nodeSet->dictionary)
+                                             : std::make_shared<NodeDictionary>();
+        }
+        nodeSet->indices.emplace(node, static_cast<uint32_t>(dictionary->size()));
+        dictionary->push_back(node);
+    }
+    if (nullptr != dictionary)
+    {
+        nodeSet->dictionary = std::move(dictionary);
+    }
+    for (auto& [name, group] : nodeSet->groups)
+    {
+        if (nullptr == group.scheduler)
+        {
+            auto interval = group.interval.count() > 0 ? group.interval : std::chrono::milliseconds(mInterval);
+            group.scheduler = std::make_shared<ScanScheduler>(interval, mAlignToWallClock);
+        }
+    }
+    nodeSet->version++;
+    mpNodeSet.store(std::move(nodeSet));
+}
+
+void Machine::applyNodeSet(const NodeSet& nodeSet)
+{
+    // 持有mClientLocker时调用，调度器周期只在这里修改
+    pruneNodeCache(nodeSet);
+    if (nodeSet.version == mAppliedVersion)
+    {
+        return;
+    }
+    for (auto& [name, group] : nodeSet.groups)
     {
-        mNodeCodes.erase(iter);
+        auto interval = group.interval.count() > 0 ? group.interval : std::chrono::milliseconds(mInterval);
+        if (group.scheduler->period() != interval)
+        {
+            group.scheduler->setPeriod(interval);
+            group.scheduler->reset();
+        }
     }
+    mAppliedVersion = nodeSet.version;
 }
 
 std::set<std::string> Machine::collectingNodes()
 {
-    std::scoped_lock lock(mClientLocker);
-    return mNodeCodes;
+    return nodeSet()->nodes;
+}
+
+std::shared_ptr<const NodeSet> Machine::nodeSet() const
+{
+    auto nodeSet = mpNodeSet.load();
+    if (nullptr == nodeSet)
+    {
+        static const auto empty = std::make_shared<const NodeSet>();
+        return empty;
+    }
+    return nodeSet;
 }
 
 std::set<std::string> Machine::allNodes()
 {
-    std::scoped_lock lock(mClientLocker);
+    std::set<std::string> nodes;
+    for (auto&& entry : *mBrowseIndex.entries())
+    {
+        nodes.insert(entry.code);
+    }
+    return nodes;
+}
+
+std::shared_ptr<const std::vector<BrowseEntry>> Machine::browseEntries()
+{
+    return mBrowseIndex.entries();
+}
 
+void Machine::setBrowseCache(const std::string& file, int refreshInterval)
+{
+    mBrowseIndex.setCacheFile(file);
+    std::scoped_lock lock(mClientLocker);
+    mBrowseRefreshInterval = std::chrono::seconds(std::max(refreshInterval, 1));
+    mNextBrowse = Clock::now();
+    if (mBrowseIndex.load())
+    {
+        // 缓存未过期时按缓存时间推迟首次遍历
+        auto age = std::chrono::seconds(std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count() - mBrowseIndex.updateTime());
+        if (age < mBrowseRefreshInterval)
+        {
+            mNextBrowse += mBrowseRefreshInterval - age;
+        }
+    }
 }
 
 void Machine::setTopic(const std::string& dist)
@@ -138,90 +478,202 @@ int Machine::interval()
     return mInterval;
 }
 
+void Machine::setReadBatchSize(int size)
+{
+    mReadBatchSize = size;
+}
 
-void Machine::start()
+int Machine::readBatchSize()
 {
-    mpReconnectTimer->start();
+    return mReadBatchSize;
 }
 
-void Machine::stop()
+void Machine::setMode(AcquisitionMode mode)
+{
+    mMode = mode;
+}
+
+AcquisitionMode Machine::mode()
+{
+    return mMode;
+}
+
+void Machine::setSubscriptionParameters(double publishingInterval, double samplingInterval, uint32_t queueSize)
 {
-    mpReconnectTimer->stop();
     std::scoped_lock lock(mClientLocker);
-    mpClient->disconnect();
+    mPublishingInterval = publishingInterval;
+    mSamplingInterval = samplingInterval;
+    mQueueSize = queueSize;
 }
 
-void Machine::setNodeValue(const std::string& nodeCode, const std::string& value)
+void Machine::setAlignToWallClock(bool align)
 {
-    try
+    mAlignToWallClock = align;
+}
+
+void Machine::setBackpressureInterval(int interval)
+{
+    mBackpressureInterval = std::max(interval, 1);
+}
+
+void Machine::setBackpressure(bool active)
+{
+    if (mBackpressure.exchange(active) != active)
     {
-        if (!isConnected())
+        if (active)
         {
-            OPCServerNotConnectException e(fmt::format("没有连接到OPC服务[{}]，指令[{},{}]上行失败！",mMachineCode, nodeCode, value));
-            e.rethrow();
+            LogWarn("OPC服务[{}]下游发送积压，按{}ms合并上报", mMachineCode, mBackpressureInterval.load());
         }
-        uint32_t index = nodeCode.find_first_of(':');
-        std::string first = nodeCode.substr(0, index);
-        std::string second = nodeCode.substr(index + 1);
-        std::scoped_lock lock(mClientLocker);
-        opcua::Node uaNode(*mpClient, opcua::NodeId(stoi(first), stoi(second)));
-        auto oldUaVar = uaNode.readValue();
-        uint32_t typeKind = oldUaVar.type()->typeKind;
-        if (!uaNode.exists())
+        else
         {
-            OPCNodeNotExistException e(fmt::format("OPC服务[{}]节点[{}]不存在",mMachineCode, nodeCode));
-            e.rethrow();
-        }
-        switch (typeKind)
-        {
-        case UA_DATATYPEKIND_BOOLEAN:
-            uaNode.writeValueScalar<bool>(string_to_bool(value));
-            break;
-        case UA_DATATYPEKIND_SBYTE:
-            uaNode.writeValueScalar<int8_t>(static_cast<int8_t>(QString::fromStdString(value).toInt()));
-            break;
-        case UA_DATATYPEKIND_BYTE:
-            uaNode.writeValueScalar<uint8_t>(static_cast<uint8_t>(QString::fromStdString(value).toInt()));
-            break;
-        case UA_DATATYPEKIND_INT16:
-            uaNode.writeValueScalar<int16_t>(QString::fromStdString(value).toShort());
-            break;
-        case UA_DATATYPEKIND_UINT16:
-            uaNode.writeValueScalar<uint16_t>(QString::fromStdString(value).toUShort());
-            break;
-        case UA_DATATYPEKIND_INT32:
-            uaNode.writeValueScalar<int32_t>(QString::fromStdString(value).toInt());
-            break;
-        case UA_DATATYPEKIND_UINT32:
-            uaNode.writeValueScalar<uint32_t>(QString::fromStdString(value).toUInt());
-            break;
-        case UA_DATATYPEKIND_INT64:
-            uaNode.writeValueScalar<int64_t>(QString::fromStdString(value).toLongLong());
-            break;
-        case UA_DATATYPEKIND_UINT64:
-            uaNode.writeValueScalar<uint64_t>(QString::fromStdString(value).toULongLong());
-            break;
-        case UA_DATATYPEKIND_FLOAT:
-            uaNode.writeValueScalar<float>(QString::fromStdString(value).toFloat());
-            break;
-        case UA_DATATYPEKIND_DOUBLE:
-            uaNode.writeValueScalar<double>(QString::fromStdString(value).toDouble());
-            break;
-        case UA_DATATYPEKIND_STRING:
-            uaNode.writeValueScalar<std::string>(value);
-            break;
-        default:
-            OPCNodeTypeNotSupportException e(fmt::format("OPC服务[{}]节点[{}]类型[{}]不被支持",mMachineCode, nodeCode, typeKind));
-            e.rethrow();
+            LogInfo("OPC服务[{}]下游发送积压解除，恢复逐周期上报", mMachineCode);
         }
     }
-    catch (...)
+}
+
+void Machine::setReconnectBackoff(int minimum, int maximum)
+{
+    std::scoped_lock lock(mClientLocker);
+    mReconnectMin = std::chrono::milliseconds(std::max(minimum, 1));
+    mReconnectMax = std::max(mReconnectMin, std::chrono::milliseconds(maximum));
+}
+
+ConnectionState Machine::connectionState() const
+{
+    return mConnectionState;
+}
+
+uint32_t Machine::reconnectAttempts() const
+{
+    return mReconnectAttempts;
+}
+
+void Machine::setReportByException(bool enabled, int heartbeat)
+{
+    mReportFilter.setEnabled(enabled);
+    mReportFilter.setHeartbeat(std::chrono::seconds(heartbeat));
+}
+
+void Machine::setDeadband(const std::string& nodeCode, const Deadband& deadband)
+{
+    mReportFilter.setDeadband(nodeCode, deadband);
+}
+
+std::map<std::string, std::pair<int, ScanStatistics>> Machine::scanStatistics()
+{
+    std::map<std::string, std::pair<int, ScanStatistics>> statistics;
+    for (auto& [name, group] : nodeSet()->groups)
     {
-        std::rethrow_exception(std::current_exception());
+        auto interval = group.interval.count() > 0 ? static_cast<int>(group.interval.count()) : mInterval.load();
+        statistics.emplace(name, std::make_pair(interval, group.scheduler->statistics()));
+    }
+    return statistics;
+}
+
+void Machine::setCommandTimeout(int timeout)
+{
+    mCommandTimeout = std::max(timeout, 1);
+}
+
+CommandStatistics Machine::commandStatistics()
+{
+    std::scoped_lock lock(mCommandLocker);
+    return mCommandStatistics;
+}
+
+void Machine::setWakeup(std::function<void()> wakeup)
+{
+    std::scoped_lock lock(mCommandLocker);
+    mWakeup = std::move(wakeup);
+}
+
+void Machine::setSampleRing(std::shared_ptr<SampleRing> ring)
+{
+    mpSampleRing = std::move(ring);
+}
+
+void Machine::setHistoryBudget(size_t bytes)
+{
+    mpHistory = std::make_unique<History>(bytes);
+}
+
+void Machine::start()
+{
+    mStarted = true;
+}
+
+void Machine::stop()
+{
+    mStarted = false;
+    std::scoped_lock lock(mClientLocker);
+    mpClient->disconnect();
+    resetSession();
+    mSessionActivated = false;
+    mConnecting = false;
+    mReactivating = false;
+    mConnectionState = ConnectionState::Disconnected;
+}
+
+void Machine::setNodeValue(const std::string& nodeCode, const std::string& value)
+{
+    auto results = setNodeValues({{nodeCode, value}});
+    auto& result = results.front();
+    if (UA_STATUSCODE_GOOD == result.status)
+    {
+        return;
+    }
+    if (UA_STATUSCODE_BADNODEIDUNKNOWN == result.status)
+    {
+        OPCNodeNotExistException e(result.message);
+        e.rethrow();
+    }
+    if (UA_STATUSCODE_BADTYPEMISMATCH == result.status)
+    {
+        OPCNodeTypeNotSupportException e(result.message);
+        e.rethrow();
+    }
+    OPCWriteFailedException e(fmt::format("OPC服务[{}]指令[{},{}]写入失败：{}", mMachineCode, nodeCode, value, result.message));
+    e.rethrow();
+}
+
+std::vector<WriteResult> Machine::setNodeValues(const std::vector<std::pair<std::string, std::string>>& writes)
+{
+    if (!isConnected())
+    {
+        OPCServerNotConnectException e(fmt::format("没有连接到OPC服务[{}]，指令上行失败！", mMachineCode));
+        e.rethrow();
+    }
+    // 指令交由工作线程发送，不与轮询争用mClientLocker，在下一批读取之前写出
+    auto command = std::make_shared<WriteCommand>();
+    command->writes = writes;
+    command->results.resize(writes.size());
+    const auto timeout = std::chrono::milliseconds(mCommandTimeout);
+    command->enqueueTime = Clock::now();
+    command->deadline = command->enqueueTime + timeout;
+    auto future = command->promise.get_future();
+    std::function<void()> wakeup;
+    {
+        std::scoped_lock lock(mCommandLocker);
+        mCommands.push_back(command);
+        wakeup = mWakeup;
+    }
+    if (wakeup)
+    {
+        wakeup();
+    }
+    if (future.wait_for(timeout) != std::future_status::ready)
+    {
+        {
+            std::scoped_lock lock(mCommandLocker);
+            mCommandStatistics.timeouts++;
+        }
+        OPCCommandTimeoutException e(fmt::format("OPC服务[{}]指令等待{}ms未完成", mMachineCode, timeout.count()));
+        e.rethrow();
     }
+    return future.get();
 }
 
-void Machine::getNode(const std::string& nodeCode,std::string& name,std::string& type,std::string& value)
+void Machine::getNode(const std::string& nodeCode, NodeValue& node)
 {
     try
     {
@@ -230,75 +682,38 @@ void Machine::getNode(const std::string& nodeCode,std::string& name,std::string&
             OPCServerNotConnectException e(fmt::format("没有连接到服务[{}]，获取节点[{}]数据失败！",mMachineCode, nodeCode));
             e.rethrow();
         }
-        uint32_t index = nodeCode.find_first_of(':');
-        if (index == std::string::npos){
-            OPCNodeCodeFormatErrorException e("解析NodeCode[{}],失败",nodeCode);
-            e.rethrow();
-        }
-        std::string first = nodeCode.substr(0, index);
-        std::string second = nodeCode.substr(index + 1);
         std::scoped_lock lock(mClientLocker);
-        opcua::Node uaNode(*mpClient, opcua::NodeId(stoi(first), stoi(second)));
-        if (!uaNode.exists())
+        // 已缓存的采集节点直接使用缓存句柄，其余节点只在本次读取中解析
+        NodeHandle temporary;
+        auto iter = mNodeCache.find(nodeCode);
+        if (iter == mNodeCache.end())
+        {
+            temporary = createNodeHandle(nodeCode);
+        }
+        auto& handle = iter != mNodeCache.end() ? iter->second : temporary;
+        resolveNodes({&handle});
+        if (!handle.exists())
         {
             OPCNodeNotExistException e(fmt::format("OPC服务[{}]节点[{}]不存在",mMachineCode, nodeCode));
             e.rethrow();
         }
-        auto uaValue = uaNode.readValue();
-        name = uaNode.readBrowseName().name();
-        switch (uint32_t typeKind = uaValue.type()->typeKind)
-        {
-        case UA_DATATYPEKIND_BOOLEAN:
-            value = uaValue.to<bool>() ? "1" : "0";
-            break;
-        case UA_DATATYPEKIND_SBYTE:
-            type = "int8_t";
-            value = QString::number(uaValue.to<int8_t>()).toStdString();
-            break;
-        case UA_DATATYPEKIND_BYTE:
-            type = "uint8_t";
-            value = QString::number(uaValue.to<uint8_t>()).toStdString();
-            break;
-        case UA_DATATYPEKIND_INT16:
-            type = "int16_t";
-            value = QString::number(uaValue.to<int16_t>()).toStdString();
-            break;
-        case UA_DATATYPEKIND_UINT16:
-            type = "uint16_t";
-            value = QString::number(uaValue.to<uint16_t>()).toStdString();
-            break;
-        case UA_DATATYPEKIND_INT32:
-            type = "int32_t";
-            value = QString::number(uaValue.to<int>()).toStdString();
-            break;
-        case UA_DATATYPEKIND_UINT32:
-            type = "uint32_t";
-            value = QString::number(uaValue.to<uint32_t>()).toStdString();
-            break;
-        case UA_DATATYPEKIND_INT64:
-            type = "int64_t";
-            value = QString::number(uaValue.to<int64_t>()).toStdString();
-            break;
-        case UA_DATATYPEKIND_UINT64:
-            type = "uint64_t";
-            value = QString::number(uaValue.to<uint64_t>()).toStdString();
-            break;
-        case UA_DATATYPEKIND_FLOAT:
-            type = "float";
-            value = QString::number(uaValue.to<float>()).toStdString();
-            break;
-        case UA_DATATYPEKIND_DOUBLE:
-            type = "double";
-            value = QString::number(uaValue.to<double>()).toStdString();
-            break;
-        case UA_DATATYPEKIND_STRING:
-            type = "string";
-            value = uaValue.to<std::string>();
-            break;
-        default:
-            LogErr("不支持的数据类型: {}!", typeKind);
-            break;
+        std::vector<opcua::ReadValueId> readIds{{handle.id, opcua::AttributeId::Value}};
+        opcua::ReadRequest request(opcua::RequestHeader{}, 0.0, opcua::TimestampsToReturn::Both, readIds);
+        auto response = opcua::services::read(*mpClient, request);
+        node.acquireTime = currentUnixMicroseconds();
+        auto serviceResult = response.responseHeader().serviceResult();
+        if (serviceResult.isBad() || response.results().empty())
+        {
+            OPCReadFailedException e(fmt::format("OPC服务[{}]读取节点[{}]失败：{}", mMachineCode, nodeCode,
+                                                 serviceResult.name()));
+            e.rethrow();
         }
+        const auto& dataValue = response.results()[0];
+        node.name = handle.browseName;
+        node.status = dataValue.hasStatus() ? dataValue.status().get() : UA_STATUSCODE_GOOD;
+        node.sourceTime = dataValue.hasSourceTimestamp() ? toUnixMicroseconds(dataValue.sourceTimestamp()) : 0;
+        node.serverTime = dataValue.hasServerTimestamp() ? toUnixMicroseconds(dataValue.serverTimestamp()) : 0;
+        formatVariant(dataValue.value(), node.type, node.value);
     }
     catch (...)
     {
@@ -306,63 +721,1290 @@ void Machine::getNode(const std::string& nodeCode,std::string& name,std::string&
     }
 }
 
-void Machine::connectServer()
+bool Machine::lastValue(const std::string& nodeCode, NodeValue& node)
 {
-    std::scoped_lock lock(mClientLocker);
-    if (!mpClient->isConnected())
+    auto snapshot = nodeSet();
+    auto iter = snapshot->indices.find(nodeCode);
+    if (iter == snapshot->indices.end())
     {
-        try
-        {
-            mpClient->connect(mUrl);
-            if (!isRunning())
-            {
-                QThread::start();
-            }
-        }
-        catch (std::exception& e)
-        {
-            LogErr("重连服务器失败：{}", e.what());
-        }
+        return false;
+    }
+    std::shared_lock lock(mLastValueLocker);
+    if (iter->second >= mLastValues.size() || !mLastValues[iter->second].valid)
+    {
+        return false;
     }
+    fillNodeValue(mLastValues[iter->second], node);
+    return true;
 }
 
-void Machine::run()
+void Machine::lastValues(std::span<const std::string> codes, std::vector<std::optional<NodeValue>>& nodes)
 {
-    while (isConnected())
+    auto snapshot = nodeSet();
+    nodes.resize(codes.size());
+    std::shared_lock lock(mLastValueLocker);
+    for (size_t i = 0; i < codes.size(); i++)
     {
-        try
+        auto iter = snapshot->indices.find(codes[i]);
+        if (iter == snapshot->indices.end() || iter->second >= mLastValues.size() ||
+            !mLastValues[iter->second].valid)
         {
-            std::vector<std::pair<std::string,std::string>> datas;
-            datas.reserve(mNodeCodes.size());
-            for (auto node : mNodeCodes)
-            {
-                std::string type;
-                std::string value;
-                std::string browseName;
-                try{
-                    getNode(node, browseName, type,value);
-                    datas.emplace_back(node, value);
-                    LogInfo("成功读取到数据,ID:[{}] Name:{} Type:{} Value:{}", node, browseName, type, value);
-                }
-                catch (Exception& e){
-                    LogErr("{}", e.message());
-                }
-            }
-            if (!datas.empty())
-            {
-                emit newData(mTopic, mMachineCode, datas);
-            }
+            nodes[i].reset();
+            continue;
         }
-        catch (std::exception& e)
+        if (!nodes[i].has_value())
         {
-            LogErr("{}", e.what());
+            nodes[i].emplace();
         }
-        msleep(mInterval);
+        // 复用上一块已分配的字符串
+        fillNodeValue(mLastValues[iter->second], *nodes[i]);
     }
 }
 
-bool Machine::isConnected()
+void Machine::fillNodeValue(const LastValue& entry, NodeValue& node)
 {
-    std::scoped_lock lock(mClientLocker);
-    return mpClient->isConnected();
+    node.name = entry.name;
+    node.type = sampleTypeName(entry.sample.value);
+    node.value.clear();
+    appendSampleValue(node.value, entry.sample.value);
+    node.status = entry.sample.status;
+    node.sourceTime = entry.sample.sourceTime;
+    node.serverTime = entry.sample.serverTime;
+    node.acquireTime = entry.sample.acquireTime;
+}
+
+void Machine::history(const std::string& nodeCode, int64_t from, int64_t to, std::vector<HistoryPoint>& points)
+{
+    if (nullptr == mpHistory)
+    {
+        OPCHistoryDisabledException e(fmt::format("OPC服务[{}]未启用历史记录", mMachineCode));
+        e.rethrow();
+    }
+    auto snapshot = nodeSet();
+    auto iter = snapshot->indices.find(nodeCode);
+    if (iter == snapshot->indices.end())
+    {
+        OPCNodeNotExistException e(fmt::format("OPC服务[{}]未采集节点[{}]", mMachineCode, nodeCode));
+        e.rethrow();
+    }
+    mpHistory->query(iter->second, from, to, points);
+}
+
+std::pair<size_t, uint64_t> Machine::historyUsage()
+{
+    if (nullptr == mpHistory)
+    {
+        return {0, 0};
+    }
+    return {mpHistory->memoryBytes(), mpHistory->pointCount()};
+}
+
+void Machine::updateLastValue(const Sample& sample, const std::string& name)
+{
+    std::unique_lock lock(mLastValueLocker);
+    if (sample.index >= mLastValues.size())
+    {
+        mLastValues.resize(sample.index + 1);
+    }
+    auto& entry = mLastValues[sample.index];
+    // 赋值复用已有字符串的容量
+    entry.sample = sample;
+    if (entry.name != name)
+    {
+        entry.name = name;
+    }
+    entry.valid = true;
+}
+
+void Machine::updateLastStatus(uint32_t index, uint32_t status, int64_t acquireTime)
+{
+    std::unique_lock lock(mLastValueLocker);
+    if (index < mLastValues.size() && mLastValues[index].valid)
+    {
+        mLastValues[index].sample.status = status;
+        mLastValues[index].sample.acquireTime = acquireTime;
+    }
+}
+
+void Machine::pruneNodeCache(const NodeSet& nodeSet)
+{
+    // 在途读取批次持有缓存句柄的指针，批次结束前不删除
+    if (nodeSet.version == mPrunedVersion || nullptr != mpReadCycle)
+    {
+        return;
+    }
+    std::erase_if(mNodeCache, [&nodeSet](const auto& item) { return !nodeSet.nodes.contains(item.first); });
+    mPrunedVersion = nodeSet.version;
+}
+
+NodeHandle& Machine::nodeHandle(const std::string& nodeCode)
+{
+    auto iter = mNodeCache.find(nodeCode);
+    if (iter != mNodeCache.end())
+    {
+        return iter->second;
+    }
+    return mNodeCache.emplace(nodeCode, createNodeHandle(nodeCode)).first->second;
+}
+
+NodeHandle Machine::createNodeHandle(const std::string& nodeCode)
+{
+    NodeHandle handle;
+    try
+    {
+        handle.id = parseNodeCode(nodeCode);
+    }
+    catch (Exception& e)
+    {
+        LogErr("{}", e.message());
+        handle.valid = false;
+        handle.status = UA_STATUSCODE_BADNODEIDINVALID;
+    }
+    return handle;
+}
+
+void Machine::resolveNodes(const std::vector<NodeHandle*>& handles)
+{
+    // 一次Read请求同时读取所有未解析节点的BrowseName与Value，Value仅用于确定数据类型
+    std::vector<NodeHandle*> unresolved;
+    std::vector<opcua::ReadValueId> readIds;
+    for (auto handle : handles)
+    {
+        if (!handle->valid || handle->resolved)
+        {
+            continue;
+        }
+        readIds.emplace_back(handle->id, opcua::AttributeId::BrowseName);
+        readIds.emplace_back(handle->id, opcua::AttributeId::Value);
+        unresolved.push_back(handle);
+    }
+    if (unresolved.empty())
+    {
+        return;
+    }
+    opcua::ReadRequest request(opcua::RequestHeader{}, 0.0, opcua::TimestampsToReturn::Neither, readIds);
+    auto response = opcua::services::read(*mpClient, request);
+    onResolveResponse(unresolved, response);
+}
+
+void Machine::onResolveResponse(const std::vector<NodeHandle*>& handles, opcua::ReadResponse& response)
+{
+    // 请求按节点依次包含BrowseName与Value两项
+    auto serviceResult = response.responseHeader().serviceResult();
+    if (serviceResult.isBad())
+    {
+        LogErr("OPC服务[{}]解析节点失败：{}", mMachineCode, serviceResult.name());
+        return;
+    }
+    auto results = response.results();
+    for (size_t i = 0; i < handles.size() && 2 * i + 1 < results.size(); i++)
+    {
+        if (nullptr == handles[i])
+        {
+            continue;
+        }
+        auto& handle = *handles[i];
+        const auto& browseName = results[2 * i];
+        const auto& value = results[2 * i + 1];
+        handle.status = browseName.hasStatus() ? browseName.status() : opcua::StatusCode(UA_STATUSCODE_GOOD);
+        if (handle.status.isBad())
+        {
+            // 节点不存在同样视为已解析，避免每个周期重复请求
+            handle.resolved = true;
+            continue;
+        }
+        handle.browseName = browseName.value().to<opcua::QualifiedName>().name();
+        if (value.hasValue() && nullptr != value.value().type())
+        {
+            handle.typeKind = value.value().type()->typeKind;
+        }
+        handle.resolved = true;
+    }
+}
+
+void Machine::invalidateNodeCache()
+{
+    for (auto& [nodeCode, handle] : mNodeCache)
+    {
+        handle.resolved = false;
+        handle.status = UA_STATUSCODE_GOOD;
+    }
+}
+
+void Machine::refreshNodeCache()
+{
+    std::scoped_lock lock(mClientLocker);
+    invalidateNodeCache();
+}
+
+Machine::Clock::time_point Machine::process(Clock::time_point now)
+{
+    std::vector<std::vector<Sample>> datas;
+    auto next = now + std::chrono::milliseconds(mInterval);
+    {
+        // HTTP请求正在同步访问该客户端时跳过本轮，不阻塞同一工作线程上的其他Machine；
+        // 标记为忙碌，由IOEngine在下一个tick重试，不能返回now，否则工作线程空转
+        std::unique_lock lock(mClientLocker, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            mBusy = true;
+            return next;
+        }
+        if (!mStarted)
+        {
+            mBusy = false;
+            return next;
+        }
+        if (mConnecting || mSessionActivated)
+        {
+            try
+            {
+                // 非阻塞地处理网络事件：连接握手、异步响应与订阅通知
+                mpClient->runIterate(0);
+            }
+            catch (std::exception& e)
+            {
+                LogDebug("OPC服务[{}]处理网络事件失败：{}", mMachineCode, e.what());
+            }
+        }
+        processConnection(now);
+        if (mSessionActivated)
+        {
+            try
+            {
+                // 指令先于本轮读取发出
+                processCommands(now);
+                // 确认服务端是否重启、原订阅是否可用之后再开始采集
+                if (0 == mActivationPending)
+                {
+                    if (AcquisitionMode::Subscription == mMode)
+                    {
+                        processSubscription();
+                        if (mSubscription.has_value())
+                        {
+                            // 通知按发布间隔到达，订阅本身不算忙碌，不需要按tick轮询
+                            next = now + std::chrono::milliseconds(
+                                std::max<int64_t>(1, static_cast<int64_t>(mRevisedPublishingInterval)));
+                        }
+                    }
+                    else
+                    {
+                        next = processPolling(now);
+                    }
+                }
+                processBrowse(now);
+            }
+            catch (std::exception& e)
+            {
+                LogErr("{}", e.what());
+            }
+        }
+        else
+        {
+            std::deque<std::shared_ptr<WriteCommand>> commands;
+            {
+                std::scoped_lock commandLock(mCommandLocker);
+                commands.swap(mCommands);
+            }
+            for (auto& command : commands)
+            {
+                failCommand(command, UA_STATUSCODE_BADNOTCONNECTED,
+                            fmt::format("没有连接到OPC服务[{}]，指令上行失败！", mMachineCode));
+            }
+            next = std::min(next, mConnecting ? mConnectDeadline : mNextConnect);
+        }
+        datas.swap(mPendingDatas);
+        mBusy = mConnecting || nullptr != mpReadCycle || mBrowseCrawler.running() || !mActiveCommands.empty() ||
+            (mSessionActivated && (mSubscriptionPending || !mPendingItems.empty() || mActivationPending > 0));
+    }
+    if (nullptr != mpHistory)
+    {
+        // 历史记录保存全部采集值，不受变化上报过滤影响
+        for (auto&& data : datas)
+        {
+            mpHistory->append(data);
+        }
+    }
+    // 字典只追加，发送时的最新字典覆盖之前产生的全部下标
+    auto nodes = datas.empty() && mCoalescedSamples.empty() ? nullptr : nodeSet();
+    auto dictionary = nullptr == nodes ? nullptr : nodes->dictionary;
+    if (nullptr == dictionary || nullptr == mpSampleRing)
+    {
+        return next;
+    }
+    const bool backpressure = mBackpressure;
+    for (auto&& data : datas)
+    {
+        mReportFilter.filter(data, *dictionary, nodes->indices, now);
+        if (data.empty())
+        {
+            continue;
+        }
+        if (backpressure)
+        {
+            // 积压期间只保留每个节点的最新样本，降低下游消息数
+            if (mCoalescedSamples.empty())
+            {
+                mNextCoalescedEmit = now + std::chrono::milliseconds(mBackpressureInterval);
+            }
+            for (auto& sample : data)
+            {
+                mCoalescedSamples[sample.index] = std::move(sample);
+            }
+            continue;
+        }
+        auto collectTime = latestAcquireTime(data);
+        mpSampleRing->push(mTopic, mMachineCode, SampleBatch{dictionary, std::move(data), collectTime});
+    }
+    if (!mCoalescedSamples.empty() && (!backpressure || now >= mNextCoalescedEmit))
+    {
+        std::vector<Sample> samples;
+        samples.reserve(mCoalescedSamples.size());
+        for (auto& [index, sample] : mCoalescedSamples)
+        {
+            samples.push_back(std::move(sample));
+        }
+        mCoalescedSamples.clear();
+        auto collectTime = latestAcquireTime(samples);
+        mpSampleRing->push(mTopic, mMachineCode, SampleBatch{dictionary, std::move(samples), collectTime});
+    }
+    else if (!mCoalescedSamples.empty())
+    {
+        next = std::min(next, mNextCoalescedEmit);
+    }
+    return next;
+}
+
+bool Machine::busy()
+{
+    return mBusy;
+}
+
+void Machine::processConnection(Clock::time_point now)
+{
+    // 单次连接尝试的超时时间
+    constexpr auto connectTimeout = std::chrono::seconds(5);
+    if (mpClient->isConnected())
+    {
+        if (!mSessionActivated)
+        {
+            onSessionActivated();
+        }
+        return;
+    }
+    if (mSessionActivated)
+    {
+        // 安全通道断开：在途请求随之失效，会话、订阅与节点缓存保留，立即尝试重新激活
+        mSessionActivated = false;
+        mReactivating = true;
+        abortRequests();
+        mNextConnect = now;
+        mConnectionState = ConnectionState::Disconnected;
+        LogWarn("OPC服务[{}]连接断开，尝试重新激活会话：{}", mMachineCode, mUrl);
+    }
+    if (mConnecting)
+    {
+        UA_SecureChannelState channelState;
+        UA_SessionState sessionState;
+        UA_StatusCode connectStatus;
+        UA_Client_getState(mpClient->handle(), &channelState, &sessionState, &connectStatus);
+        bool failed = UA_STATUSCODE_GOOD != connectStatus && UA_SECURECHANNELSTATE_CLOSED == channelState;
+        if (!failed && now < mConnectDeadline)
+        {
+            return;
+        }
+        if (failed)
+        {
+            LogErr("重连服务器失败：OPC服务[{}]{}", mMachineCode, UA_StatusCode_name(connectStatus));
+        }
+        else
+        {
+            LogErr("重连服务器失败：OPC服务[{}]连接超时", mMachineCode);
+        }
+        mConnecting = false;
+        // 只关闭安全通道，会话由服务端决定是否保留，下次连接时优先重新激活
+        UA_Client_disconnectSecureChannel(mpClient->handle());
+        mConnectionState = ConnectionState::Disconnected;
+        scheduleReconnect(now);
+        return;
+    }
+    if (now < mNextConnect)
+    {
+        return;
+    }
+    try
+    {
+        mpClient->connectAsync(mUrl);
+        mConnecting = true;
+        mConnectDeadline = now + connectTimeout;
+        mConnectionState = mReactivating ? ConnectionState::Reactivating : ConnectionState::Connecting;
+    }
+    catch (std::exception& e)
+    {
+        LogErr("重连服务器失败：{}", e.what());
+        scheduleReconnect(now);
+    }
+}
+
+void Machine::scheduleReconnect(Clock::time_point now)
+{
+    // 抖动指数退避：第n次失败后等待[d/2, d]，d = min(最小间隔 * 2^n, 最大间隔)，
+    // 避免大量设备同时恢复时集中重连
+    auto attempts = std::min<uint32_t>(mReconnectAttempts, 20);
+    auto delay = std::min(mReconnectMin * (int64_t{1} << attempts), mReconnectMax);
+    std::uniform_int_distribution<int64_t> distribution(delay.count() / 2, delay.count());
+    mNextConnect = now + std::chrono::milliseconds(distribution(mRandom));
+    mReconnectAttempts++;
+}
+
+void Machine::onSessionActivated()
+{
+    mSessionActivated = true;
+    mConnecting = false;
+    bool reactivated = mReactivating;
+    mReactivating = false;
+    mReconnectAttempts = 0;
+    mSessionEpoch++;
+    mActivationPending = 0;
+    // 激活时的请求都异步发出，不在工作线程上等待服务端响应
+    requestServerStartTime();
+    if (reactivated && mSubscription.has_value())
+    {
+        resumeSubscription();
+    }
+    else
+    {
+        resetSubscription();
+    }
+    auto nodes = nodeSet();
+    mAppliedVersion = 0;
+    applyNodeSet(*nodes);
+    // 重新连接后首批数据全部上报
+    mReportFilter.reset();
+    for (auto& [name, group] : nodes->groups)
+    {
+        group.scheduler->setAlignToWallClock(mAlignToWallClock);
+        group.scheduler->reset();
+    }
+    mConnectionState = ConnectionState::Connected;
+    if (reactivated)
+    {
+        LogInfo("OPC服务[{}]会话重新激活成功：{}", mMachineCode, mUrl);
+    }
+    else
+    {
+        LogInfo("连接OPC服务[{}]成功：{}", mMachineCode, mUrl);
+    }
+}
+
+void Machine::requestServerStartTime()
+{
+    mActivationPending++;
+    try
+    {
+        std::vector<opcua::ReadValueId> readIds;
+        readIds.emplace_back(opcua::NodeId(0, UA_NS0ID_SERVER_SERVERSTATUS_STARTTIME), opcua::AttributeId::Value);
+        opcua::ReadRequest request(opcua::RequestHeader{}, 0.0, opcua::TimestampsToReturn::Neither, readIds);
+        opcua::services::readAsync(*mpClient, request, [this, epoch = mSessionEpoch](opcua::ReadResponse& response)
+        {
+            if (epoch != mSessionEpoch)
+            {
+                return;
+            }
+            mActivationPending--;
+            int64_t startTime = 0;
+            try
+            {
+                auto serviceResult = response.responseHeader().serviceResult();
+                auto results = response.results();
+                if (serviceResult.isBad() || results.empty() || !results[0].hasValue())
+                {
+                    LogWarn("OPC服务[{}]读取服务端启动时间失败：{}", mMachineCode,
+                            serviceResult.isBad() ? serviceResult.name() : "无返回值");
+                }
+                else
+                {
+                    startTime = results[0].value().to<opcua::DateTime>().get();
+                }
+            }
+            catch (std::exception& e)
+            {
+                LogWarn("OPC服务[{}]读取服务端启动时间失败：{}", mMachineCode, e.what());
+            }
+            updateServerStartTime(startTime);
+        });
+    }
+    catch (std::exception& e)
+    {
+        mActivationPending--;
+        LogWarn("OPC服务[{}]读取服务端启动时间失败：{}", mMachineCode, e.what());
+        updateServerStartTime(0);
+    }
+}
+
+void Machine::updateServerStartTime(int64_t startTime)
+{
+    // 服务端未重启时节点ID与数据类型不变，节点缓存继续有效
+    if (0 == startTime || startTime != mServerStartTime)
+    {
+        invalidateNodeCache();
+    }
+    mServerStartTime = startTime;
+}
+
+void Machine::resumeSubscription()
+{
+    // 会话被重新激活时服务端保留订阅；会话已重建则订阅失效，需重新创建
+    mActivationPending++;
+    try
+    {
+        opcua::SetPublishingModeRequest request(opcua::RequestHeader{}, true, {mSubscription->subscriptionId()});
+        opcua::services::setPublishingModeAsync(*mpClient, request,
+                                                [this, epoch = mSessionEpoch](opcua::SetPublishingModeResponse& response)
+        {
+            if (epoch != mSessionEpoch)
+            {
+                return;
+            }
+            mActivationPending--;
+            auto status = response.responseHeader().serviceResult();
+            if (status.isGood())
+            {
+                auto results = response.results();
+                status = results.empty() ? opcua::StatusCode(UA_STATUSCODE_BADUNEXPECTEDERROR) : results[0];
+            }
+            if (status.isBad())
+            {
+                LogWarn("OPC服务[{}]原订阅已失效，重新创建：{}", mMachineCode, status.name());
+                resetSubscription();
+            }
+        });
+    }
+    catch (std::exception& e)
+    {
+        mActivationPending--;
+        LogWarn("OPC服务[{}]原订阅已失效，重新创建：{}", mMachineCode, e.what());
+        resetSubscription();
+    }
+}
+
+void Machine::resetSession()
+{
+    // 会话失效后订阅与在途请求随之失效，仅丢弃本地状态
+    abortRequests();
+    resetSubscription();
+}
+
+void Machine::abortRequests()
+{
+    mpReadCycle = nullptr;
+    if (mBrowseCrawler.running())
+    {
+        // 被中断的浏览在会话恢复后立即重新开始
+        mNextBrowse = Clock::now();
+    }
+    mBrowseCrawler.cancel();
+    // 在途指令立即结束，之后到达的回调不再处理
+    auto commands = std::move(mActiveCommands);
+    mActiveCommands.clear();
+    for (auto& command : commands)
+    {
+        failCommand(command, UA_STATUSCODE_BADSESSIONCLOSED,
+                    fmt::format("OPC服务[{}]会话已关闭，指令结果未知", mMachineCode));
+    }
+}
+
+void Machine::resetSubscription()
+{
+    mSubscription.reset();
+    mSubscriptionPending = false;
+    mSubscriptionEpoch++;
+    mMonitoredItems.clear();
+    mPendingItems.clear();
+    mRejectedNodes.clear();
+}
+
+Machine::Clock::time_point Machine::processPolling(Clock::time_point now)
+{
+    // 编辑在下一个周期取到新快照时生效
+    auto nodes = nodeSet();
+    applyNodeSet(*nodes);
+    auto next = now + std::chrono::milliseconds(mInterval);
+    for (auto& [name, group] : nodes->groups)
+    {
+        if (!group.nodes.empty())
+        {
+            next = std::min(next, group.scheduler->nextDeadline());
+        }
+    }
+    // 上一轮读取尚未完成时不发起新请求，到期的组会在完成后立即开始并计入抖动与超时；
+    // 在途期间由引擎按tick驱动，这里不返回已过期的时间点以免空转
+    if (nullptr != mpReadCycle)
+    {
+        // 上一批响应时有指令等待，剩余批次在指令发出后继续
+        if (!mpReadCycle->inFlight)
+        {
+            issueReadBatch(mpReadCycle);
+        }
+        return std::max(next, now + std::chrono::milliseconds(mInterval));
+    }
+    if (now < next)
+    {
+        return next;
+    }
+    // 到期的各组合并为一次批量读取
+    auto cycle = std::make_shared<ReadCycle>();
+    std::set<std::string> dueNodes;
+    for (auto& [name, group] : nodes->groups)
+    {
+        if (group.nodes.empty() || !group.scheduler->due(now))
+        {
+            continue;
+        }
+        group.scheduler->begin(now);
+        dueNodes.insert(group.nodes.begin(), group.nodes.end());
+        cycle->schedulers.push_back(group.scheduler);
+    }
+    for (auto&& nodeCode : dueNodes)
+    {
+        auto& handle = nodeHandle(nodeCode);
+        if (!handle.exists())
+        {
+            continue;
+        }
+        cycle->entries.push_back({nodeCode, nodes->indices.at(nodeCode), &handle, !handle.resolved});
+    }
+    if (cycle->entries.empty())
+    {
+        for (auto& scheduler : cycle->schedulers)
+        {
+            scheduler->end(now);
+        }
+        return now;
+    }
+    cycle->samples.reserve(cycle->entries.size());
+    cycle->batchSize = mReadBatchSize > 0 ? mReadBatchSize.load() : cycle->entries.size();
+    mpReadCycle = cycle;
+    issueReadBatch(cycle);
+    return now + std::chrono::milliseconds(mInterval);
+}
+
+void Machine::issueReadBatch(const std::shared_ptr<ReadCycle>& cycle)
+{
+    // 同一时刻只有一批读取在途，指令最多等待一批读取的响应时间
+    const size_t begin = cycle->next;
+    const size_t end = std::min(begin + cycle->batchSize, cycle->entries.size());
+    std::vector<opcua::ReadValueId> readIds;
+    readIds.reserve(end - begin);
+    for (size_t i = begin; i < end; i++)
+    {
+        auto& entry = cycle->entries[i];
+        if (entry.resolving)
+        {
+            readIds.emplace_back(entry.handle->id, opcua::AttributeId::BrowseName);
+        }
+        readIds.emplace_back(entry.handle->id, opcua::AttributeId::Value);
+    }
+    cycle->next = end;
+    cycle->inFlight = true;
+    try
+    {
+        opcua::ReadRequest request(opcua::RequestHeader{}, 0.0, opcua::TimestampsToReturn::Both, readIds);
+        opcua::services::readAsync(*mpClient, request, [this, cycle, begin, end](opcua::ReadResponse& response)
+        {
+            onReadResponse(cycle, begin, end, response);
+        });
+    }
+    catch (std::exception& e)
+    {
+        // 发送失败时放弃本轮，调度器照常推进
+        LogErr("OPC服务[{}]批量读取失败：{}", mMachineCode, e.what());
+        auto now = Clock::now();
+        for (auto& scheduler : cycle->schedulers)
+        {
+            scheduler->end(now);
+        }
+        mpReadCycle = nullptr;
+    }
+}
+
+void Machine::onReadResponse(const std::shared_ptr<ReadCycle>& cycle, size_t begin, size_t end,
+                             opcua::ReadResponse& response)
+{
+    // 回调在持有mClientLocker的线程中执行；会话已重置的过期周期直接丢弃
+    if (cycle != mpReadCycle)
+    {
+        return;
+    }
+    // 响应返回时记录采集时间，不受后续排队与序列化延迟影响
+    const auto acquireTime = currentUnixMicroseconds();
+    auto serviceResult = response.responseHeader().serviceResult();
+    if (serviceResult.isBad())
+    {
+        LogErr("OPC服务[{}]批量读取失败：{}", mMachineCode, serviceResult.name());
+    }
+    else
+    {
+        auto results = response.results();
+        size_t index = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            auto& entry = cycle->entries[i];
+            auto& handle = *entry.handle;
+            if (entry.resolving)
+            {
+                if (index >= results.size())
+                {
+                    break;
+                }
+                const auto& browseName = results[index++];
+                if (!(browseName.hasStatus() && browseName.status().isBad()))
+                {
+                    handle.browseName = browseName.value().to<opcua::QualifiedName>().name();
+                }
+                handle.resolved = true;
+            }
+            if (index >= results.size())
+            {
+                break;
+            }
+            const auto& dataValue = results[index++];
+            handle.status = dataValue.hasStatus() ? dataValue.status() : opcua::StatusCode(UA_STATUSCODE_GOOD);
+            if (handle.status.isBad())
+            {
+                LogErr("OPC服务[{}]节点[{}]读取失败：{}", mMachineCode, entry.code, handle.status.name());
+                updateLastStatus(entry.index, handle.status.get(), acquireTime);
+                continue;
+            }
+            Sample sample;
+            sample.index = entry.index;
+            if (toSample(dataValue, acquireTime, sample))
+            {
+                handle.typeKind = dataValue.value().type()->typeKind;
+                updateLastValue(sample, handle.browseName);
+                cycle->samples.push_back(std::move(sample));
+            }
+        }
+    }
+    cycle->inFlight = false;
+    if (cycle->next < cycle->entries.size())
+    {
+        // 有指令等待时由process先发送指令，再继续下一批
+        if (!hasPendingCommands())
+        {
+            issueReadBatch(cycle);
+        }
+        return;
+    }
+    auto now = Clock::now();
+    for (auto& scheduler : cycle->schedulers)
+    {
+        scheduler->end(now);
+    }
+    mPendingDatas.emplace_back(std::move(cycle->samples));
+    mpReadCycle = nullptr;
+}
+
+bool Machine::hasPendingCommands()
+{
+    std::scoped_lock lock(mCommandLocker);
+    return !mCommands.empty();
+}
+
+void Machine::processCommands(Clock::time_point now)
+{
+    std::deque<std::shared_ptr<WriteCommand>> commands;
+    {
+        std::scoped_lock lock(mCommandLocker);
+        commands.swap(mCommands);
+    }
+    for (auto& command : commands)
+    {
+        if (now >= command->deadline)
+        {
+            failCommand(command, UA_STATUSCODE_BADTIMEOUT, fmt::format("OPC服务[{}]指令超时未发送", mMachineCode));
+            continue;
+        }
+        // 尚未获知数据类型的节点先异步读取一次，响应后再写入；
+        // 句柄属于指令本身，请求来自外部的任意节点不会进入缓存
+        std::vector<NodeHandle*> handles;
+        std::vector<opcua::ReadValueId> readIds;
+        for (auto&& [nodeCode, value] : command->writes)
+        {
+            if (command->handles.contains(nodeCode))
+            {
+                continue;
+            }
+            auto iter = mNodeCache.find(nodeCode);
+            auto& handle = command->handles.emplace(
+                nodeCode, iter != mNodeCache.end() ? iter->second : createNodeHandle(nodeCode)).first->second;
+            if (!handle.valid || handle.resolved)
+            {
+                continue;
+            }
+            readIds.emplace_back(handle.id, opcua::AttributeId::BrowseName);
+            readIds.emplace_back(handle.id, opcua::AttributeId::Value);
+            handles.push_back(&handle);
+        }
+        if (handles.empty())
+        {
+            issueWrite(command);
+            continue;
+        }
+        mActiveCommands.insert(command);
+        try
+        {
+            opcua::ReadRequest request(opcua::RequestHeader{}, 0.0, opcua::TimestampsToReturn::Neither, readIds);
+            opcua::services::readAsync(*mpClient, request, [this, command, handles](opcua::ReadResponse& response)
+            {
+                if (0 == mActiveCommands.erase(command))
+                {
+                    return;
+                }
+                auto serviceResult = response.responseHeader().serviceResult();
+                if (serviceResult.isBad())
+                {
+                    failCommand(command, serviceResult.get(), std::string(serviceResult.name()));
+                    return;
+                }
+                onResolveResponse(handles, response);
+                // 采集节点的解析结果同步回缓存
+                for (auto& [nodeCode, handle] : command->handles)
+                {
+                    auto iter = mNodeCache.find(nodeCode);
+                    if (iter != mNodeCache.end() && !iter->second.resolved && handle.resolved)
+                    {
+                        iter->second = handle;
+                    }
+                }
+                issueWrite(command);
+            });
+        }
+        catch (std::exception& e)
+        {
+            mActiveCommands.erase(command);
+            failCommand(command, UA_STATUSCODE_BADCOMMUNICATIONERROR, e.what());
+        }
+    }
+}
+
+void Machine::issueWrite(const std::shared_ptr<WriteCommand>& command)
+{
+    std::vector<opcua::WriteValue> writeValues;
+    // writeValues中每一项对应的writes下标
+    std::vector<size_t> positions;
+    writeValues.reserve(command->writes.size());
+    positions.reserve(command->writes.size());
+    for (size_t i = 0; i < command->writes.size(); i++)
+    {
+        auto& [nodeCode, value] = command->writes[i];
+        auto& handle = command->handles.at(nodeCode);
+        if (!handle.exists())
+        {
+            command->results[i] = {UA_STATUSCODE_BADNODEIDUNKNOWN,
+                                   fmt::format("OPC服务[{}]节点[{}]不存在", mMachineCode, nodeCode)};
+            continue;
+        }
+        opcua::Variant variant;
+        try
+        {
+            if (!toVariant(handle.typeKind, value, variant))
+            {
+                command->results[i] = {UA_STATUSCODE_BADTYPEMISMATCH,
+                                       fmt::format("OPC服务[{}]节点[{}]类型[{}]不被支持", mMachineCode, nodeCode,
+                                                   handle.typeKind)};
+                continue;
+            }
+        }
+        catch (std::exception& e)
+        {
+            command->results[i] = {UA_STATUSCODE_BADTYPEMISMATCH, e.what()};
+            continue;
+        }
+        writeValues.emplace_back(handle.id, opcua::AttributeId::Value, std::string_view{},
+                                 opcua::DataValue(std::move(variant)));
+        positions.push_back(i);
+    }
+    if (writeValues.empty())
+    {
+        completeCommand(command);
+        return;
+    }
+    mActiveCommands.insert(command);
+    try
+    {
+        opcua::WriteRequest request(opcua::RequestHeader{}, writeValues);
+        opcua::services::writeAsync(*mpClient, request, [this, command, positions](opcua::WriteResponse& response)
+        {
+            if (0 == mActiveCommands.erase(command))
+            {
+                return;
+            }
+            auto serviceResult = response.responseHeader().serviceResult();
+            auto statuses = response.results();
+            for (size_t i = 0; i < positions.size(); i++)
+            {
+                auto status = serviceResult.isBad() ? serviceResult : (i < statuses.size() ? statuses[i] : opcua::StatusCode(UA_STATUSCODE_BADUNEXPECTEDERROR));
+                command->results[positions[i]] = {status.get(), std::string(status.name())};
+            }
+            completeCommand(command);
+        });
+    }
+    catch (std::exception& e)
+    {
+        mActiveCommands.erase(command);
+        for (auto position : positions)
+        {
+            command->results[position] = {UA_STATUSCODE_BADCOMMUNICATIONERROR, e.what()};
+        }
+        completeCommand(command);
+    }
+}
+
+void Machine::failCommand(const std::shared_ptr<WriteCommand>& command, uint32_t status, const std::string& message)
+{
+    for (auto& result : command->results)
+    {
+        // 已确定失败原因的节点保留原结果
+        if (UA_STATUSCODE_GOOD == result.status)
+        {
+            result = {status, message};
+        }
+    }
+    completeCommand(command);
+}
+
+void Machine::completeCommand(const std::shared_ptr<WriteCommand>& command)
+{
+    if (command->completed)
+    {
+        return;
+    }
+    command->completed = true;
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - command->enqueueTime).count();
+    bool failed = std::any_of(command->results.begin(), command->results.end(), [](const WriteResult& result)
+    {
+        return UA_STATUSCODE_GOOD != result.status;
+    });
+    {
+        std::scoped_lock lock(mCommandLocker);
+        auto& statistics = mCommandStatistics;
+        statistics.commands++;
+        statistics.failures += failed ? 1 : 0;
+        statistics.lastLatency = latency;
+        statistics.maxLatency = std::max(statistics.maxLatency, latency);
+        statistics.meanLatency += (static_cast<double>(latency) - statistics.meanLatency) /
+            static_cast<double>(statistics.commands);
+    }
+    command->promise.set_value(command->results);
+}
+
+void Machine::processBrowse(Clock::time_point now)
+{
+    // 本轮浏览因请求发送失败而放弃时，等待该间隔后重新开始
+    constexpr auto browseRetryInterval = std::chrono::seconds(60);
+    if (!mBrowseCrawler.running())
+    {
+        if (now >= mNextBrowse)
+        {
+            LogInfo("开始浏览OPC服务[{}]地址空间", mMachineCode);
+            mNextBrowse = now + std::min<std::chrono::seconds>(browseRetryInterval, mBrowseRefreshInterval);
+            mBrowseCrawler.start(*mpClient);
+        }
+        return;
+    }
+    if (!mBrowseCrawler.step(*mpClient))
+    {
+        return;
+    }
+    // 每轮为完整的重新遍历；遍历期间仍使用旧索引提供查询，完成后整体替换，内容变化时才写入缓存
+    auto entries = mBrowseCrawler.takeEntries();
+    auto current = mBrowseIndex.entries();
+    bool changed = current->size() != entries.size() ||
+        !std::equal(entries.begin(), entries.end(), current->begin(), [](auto& a, auto& b)
+        {
+            return a.code == b.code && a.path == b.path && a.nodeClass == b.nodeClass && a.dataType == b.dataType;
+        });
+    auto updateTime = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    LogInfo("OPC服务[{}]地址空间浏览完成，节点数：{}", mMachineCode, entries.size());
+    mBrowseIndex.replace(std::move(entries), updateTime);
+    if (changed)
+    {
+        // 持有mClientLocker的I/O线程上不做文件写入
+        mBrowseIndex.saveAsync();
+    }
+    mNextBrowse = now + mBrowseRefreshInterval;
+}
+
+void Machine::processSubscription()
+{
+    if (!mSubscription.has_value())
+    {
+        if (mSubscriptionPending)
+        {
+            return;
+        }
+        opcua::SubscriptionParameters subscriptionParameters{};
+        subscriptionParameters.publishingInterval = mPublishingInterval;
+        mSubscriptionPending = true;
+        try
+        {
+            opcua::services::createSubscriptionAsync(
+                *mpClient, subscriptionParameters, true, {}, {},
+                [this, epoch = mSubscriptionEpoch](opcua::CreateSubscriptionResponse& response)
+                {
+                    if (epoch != mSubscriptionEpoch)
+                    {
+                        return;
+                    }
+                    mSubscriptionPending = false;
+                    auto serviceResult = response.responseHeader().serviceResult();
+                    if (serviceResult.isBad())
+                    {
+                        // 下一轮重新创建
+                        LogErr("OPC服务[{}]创建订阅失败：{}", mMachineCode, serviceResult.name());
+                        return;
+                    }
+                    mSubscription.emplace(*mpClient, response.subscriptionId());
+                    mRevisedPublishingInterval = response.revisedPublishingInterval();
+                    LogInfo("OPC服务[{}]创建订阅成功，发布间隔{}ms", mMachineCode, mRevisedPublishingInterval);
+                });
+        }
+        catch (std::exception& e)
+        {
+            mSubscriptionPending = false;
+            LogErr("OPC服务[{}]创建订阅失败：{}", mMachineCode, e.what());
+        }
+        return;
+    }
+    // 同步监控项与采集节点集合，新增与移除的节点各合并为一次请求
+    auto snapshot = nodeSet();
+    pruneNodeCache(*snapshot);
+    const auto& nodes = snapshot->nodes;
+    std::vector<uint32_t> removedItems;
+    for (auto iter = mMonitoredItems.begin(); iter != mMonitoredItems.end();)
+    {
+        if (!nodes.contains(iter->first))
+        {
+            removedItems.push_back(iter->second);
+            iter = mMonitoredItems.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+    if (!removedItems.empty())
+    {
+        deleteMonitoredItems(removedItems);
+    }
+    std::erase_if(mRejectedNodes, [&nodes](const std::string& nodeCode) { return !nodes.contains(nodeCode); });
+    // 监控项回调携带节点浏览名，未解析的节点先解析，已解析的节点直接创建
+    std::vector<std::string> unresolvedNodes;
+    std::vector<std::string> addedNodes;
+    for (auto&& nodeCode : nodes)
+    {
+        if (mMonitoredItems.contains(nodeCode) || mRejectedNodes.contains(nodeCode) ||
+            mPendingItems.contains(nodeCode))
+        {
+            continue;
+        }
+        auto& handle = nodeHandle(nodeCode);
+        if (!handle.valid)
+        {
+            mRejectedNodes.insert(nodeCode);
+        }
+        else if (!handle.resolved)
+        {
+            unresolvedNodes.push_back(nodeCode);
+        }
+        else if (!handle.exists())
+        {
+            LogErr("OPC服务[{}]节点[{}]不存在，不创建监控项", mMachineCode, nodeCode);
+            mRejectedNodes.insert(nodeCode);
+        }
+        else
+        {
+            addedNodes.push_back(nodeCode);
+        }
+    }
+    if (!unresolvedNodes.empty())
+    {
+        resolveMonitoredNodes(std::move(unresolvedNodes));
+    }
+    if (!addedNodes.empty())
+    {
+        createMonitoredItems(*snapshot, std::move(addedNodes));
+    }
+}
+
+void Machine::resolveMonitoredNodes(std::vector<std::string> nodeCodes)
+{
+    // 与resolveNodes相同，按节点依次读取BrowseName与Value
+    std::vector<opcua::ReadValueId> readIds;
+    readIds.reserve(2 * nodeCodes.size());
+    for (auto&& nodeCode : nodeCodes)
+    {
+        auto& handle = nodeHandle(nodeCode);
+        readIds.emplace_back(handle.id, opcua::AttributeId::BrowseName);
+        readIds.emplace_back(handle.id, opcua::AttributeId::Value);
+    }
+    mPendingItems.insert(nodeCodes.begin(), nodeCodes.end());
+    try
+    {
+        opcua::ReadRequest request(opcua::RequestHeader{}, 0.0, opcua::TimestampsToReturn::Neither, readIds);
+        opcua::services::readAsync(*mpClient, request,
+                                   [this, nodeCodes, epoch = mSubscriptionEpoch](opcua::ReadResponse& response)
+        {
+            if (epoch != mSubscriptionEpoch)
+            {
+                return;
+            }
+            std::vector<NodeHandle*> handles;
+            handles.reserve(nodeCodes.size());
+            for (auto&& nodeCode : nodeCodes)
+            {
+                mPendingItems.erase(nodeCode);
+                // 等待响应期间已移除的节点不再写回缓存
+                auto iter = mNodeCache.find(nodeCode);
+                handles.push_back(iter != mNodeCache.end() ? &iter->second : nullptr);
+            }
+            // 解析失败的节点保持未解析，下一轮重新请求
+            onResolveResponse(handles, response);
+        });
+    }
+    catch (std::exception& e)
+    {
+        LogErr("OPC服务[{}]解析节点失败：{}", mMachineCode, e.what());
+        for (auto&& nodeCode : nodeCodes)
+        {
+            mPendingItems.erase(nodeCode);
+        }
+    }
+}
+
+void Machine::createMonitoredItems(const NodeSet& snapshot, std::vector<std::string> nodeCodes)
+{
+    std::vector<opcua::MonitoredItemCreateRequest> items;
+    std::vector<opcua::services::DataChangeNotificationCallback> dataChangeCallbacks;
+    std::vector<opcua::services::DeleteMonitoredItemCallback> deleteCallbacks;
+    items.reserve(nodeCodes.size());
+    dataChangeCallbacks.reserve(nodeCodes.size());
+    deleteCallbacks.resize(nodeCodes.size());
+    for (auto&& nodeCode : nodeCodes)
+    {
+        auto& handle = nodeHandle(nodeCode);
+        auto samplingInterval = mSamplingInterval;
+        for (auto& [name, group] : snapshot.groups)
+        {
+            // 非默认组的节点按组周期采样
+            if (group.interval.count() > 0 && group.nodes.contains(nodeCode))
+            {
+                samplingInterval = static_cast<double>(group.interval.count());
+            }
+        }
+        items.emplace_back(opcua::ReadValueId(handle.id, opcua::AttributeId::Value), opcua::MonitoringMode::Reporting,
+                           opcua::MonitoringParameters(samplingInterval, {}, mQueueSize, true));
+        auto index = snapshot.indices.at(nodeCode);
+        dataChangeCallbacks.emplace_back(
+            [this, nodeCode, index, name = handle.browseName](opcua::IntegerId, opcua::IntegerId,
+                                                              const opcua::DataValue& dataValue)
+            {
+                const auto acquireTime = currentUnixMicroseconds();
+                if (dataValue.hasStatus() && dataValue.status().isBad())
+                {
+                    LogErr("OPC服务[{}]节点[{}]订阅数据异常：{}", mMachineCode, nodeCode, dataValue.status().name());
+                    updateLastStatus(index, dataValue.status().get(), acquireTime);
+                    return;
+                }
+                Sample sample;
+                sample.index = index;
+                if (toSample(dataValue, acquireTime, sample))
+                {
+                    updateLastValue(sample, name);
+                    // 同一轮网络事件中的通知合并为一批发送
+                    if (mPendingDatas.empty())
+                    {
+                        mPendingDatas.emplace_back();
+                    }
+                    mPendingDatas.back().push_back(std::move(sample));
+                }
+            });
+    }
+    mPendingItems.insert(nodeCodes.begin(), nodeCodes.end());
+    try
+    {
+        opcua::CreateMonitoredItemsRequest request(opcua::RequestHeader{}, mSubscription->subscriptionId(),
+                                                   opcua::TimestampsToReturn::Both, items);
+        opcua::services::createMonitoredItemsDataChangeAsync(
+            *mpClient, request, dataChangeCallbacks, deleteCallbacks,
+            [this, nodeCodes, epoch = mSubscriptionEpoch](opcua::CreateMonitoredItemsResponse& response)
+            {
+                if (epoch != mSubscriptionEpoch)
+                {
+                    return;
+                }
+                for (auto&& nodeCode : nodeCodes)
+                {
+                    mPendingItems.erase(nodeCode);
+                }
+                auto serviceResult = response.responseHeader().serviceResult();
+                if (serviceResult.isBad())
+                {
+                    // 整个请求失败时下一轮重试
+                    LogErr("OPC服务[{}]创建监控项失败：{}", mMachineCode, serviceResult.name());
+                    return;
+                }
+                auto results = response.results();
+                for (size_t i = 0; i < nodeCodes.size(); i++)
+                {
+                    auto status = i < results.size() ? results[i].statusCode()
+                                                     : opcua::StatusCode(UA_STATUSCODE_BADUNEXPECTEDERROR);
+                    if (status.isBad())
+                    {
+                        LogErr("OPC服务[{}]节点[{}]创建监控项失败：{}", mMachineCode, nodeCodes[i], status.name());
+                        mRejectedNodes.insert(nodeCodes[i]);
+                        continue;
+                    }
+                    mMonitoredItems[nodeCodes[i]] = results[i].monitoredItemId();
+                }
+                LogInfo("OPC服务[{}]创建监控项{}个", mMachineCode, mMonitoredItems.size());
+            });
+    }
+    catch (std::exception& e)
+    {
+        LogErr("OPC服务[{}]创建监控项失败：{}", mMachineCode, e.what());
+        for (auto&& nodeCode : nodeCodes)
+        {
+            mPendingItems.erase(nodeCode);
+        }
+    }
+}
+
+void Machine::deleteMonitoredItems(const std::vector<uint32_t>& monitoredItemIds)
+{
+    try
+    {
+        opcua::DeleteMonitoredItemsRequest request(opcua::RequestHeader{}, mSubscription->subscriptionId(),
+                                                   monitoredItemIds);
+        opcua::services::deleteMonitoredItemsAsync(*mpClient, request,
+                                                   [this](opcua::DeleteMonitoredItemsResponse& response)
+        {
+            auto serviceResult = response.responseHeader().serviceResult();
+            if (serviceResult.isBad())
+            {
+                LogWarn("OPC服务[{}]删除监控项失败：{}", mMachineCode, serviceResult.name());
+            }
+        });
+    }
+    catch (std::exception& e)
+    {
+        LogWarn("OPC服务[{}]删除监控项失败：{}", mMachineCode, e.what());
+    }
+}
+
+bool Machine::isConnected()
+{
+    return ConnectionState::Connected == mConnectionState;
 }
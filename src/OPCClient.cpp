@@ -5,11 +5,138 @@
 #include <yaml-cpp/yaml.h>
 #include "Logger.h"
 #include <QDateTime>
+#include <rapidjson/document.h>
 
 IMPLEMENT_EXCEPTION(OPCClientNotExistException, ExistsException, "OPC客户端不存在")
 IMPLEMENT_EXCEPTION(HttpRuntimeError, RuntimeException, "Http响应时出错")
 IMPLEMENT_EXCEPTION(HttpUnsupportedSearchType, HttpRuntimeError, "Http不支持的查询操作")
 
+namespace
+{
+    // 批量查询最新值时每次输出的节点数，响应按块发送，内存占用与节点总数无关
+    constexpr size_t ValueStreamChunk = 256;
+
+    struct ValueStream {
+        struct Target {
+            std::string machine;
+            std::shared_ptr<Machine> client;
+            std::vector<std::string> codes;
+        };
+
+        std::vector<Target> targets;
+        std::string message;
+        size_t target = 0;
+        size_t position = 0;
+        bool started = false;
+        std::vector<std::optional<NodeValue>> nodes;
+        // 每块发送后清空，writer保留嵌套状态继续写下一块
+        rapidjson::StringBuffer sb;
+        rapidjson::Writer<rapidjson::StringBuffer> writer{sb};
+    };
+
+    // 未指定节点时查询该设备正在采集的全部节点
+    ValueStream::Target valueTarget(const std::string& machine, const std::shared_ptr<Machine>& client,
+                                    std::vector<std::string> codes)
+    {
+        if (codes.empty())
+        {
+            auto nodes = client->collectingNodes();
+            codes.assign(nodes.begin(), nodes.end());
+        }
+        return ValueStream::Target{machine, client, std::move(codes)};
+    }
+
+    bool writeValueChunk(ValueStream& stream, httplib::DataSink& sink)
+    {
+        auto& writer = stream.writer;
+        if (!stream.started)
+        {
+            writer.StartObject();
+            writer.Key("code");writer.Int(200);
+            writer.Key("message");writer.String(stream.message.c_str(), stream.message.size());
+            writer.Key("data");
+            writer.StartArray();
+            stream.started = true;
+        }
+        size_t written = 0;
+        while (stream.target < stream.targets.size() && written < ValueStreamChunk)
+        {
+            auto& target = stream.targets[stream.target];
+            if (0 == stream.position)
+            {
+                writer.StartObject();
+                writer.Key("machine");writer.String(target.machine.c_str(), target.machine.size());
+                writer.Key("nodes");
+                writer.StartArray();
+            }
+            auto count = std::min(ValueStreamChunk - written, target.codes.size() - stream.position);
+            std::span<const std::string> codes(target.codes.data() + stream.position, count);
+            target.client->lastValues(codes, stream.nodes);
+            for (size_t i = 0; i < count; i++)
+            {
+                writer.StartObject();
+                writer.Key("code");writer.String(codes[i].c_str(), codes[i].size());
+                if (stream.nodes[i].has_value())
+                {
+                    auto& node = *stream.nodes[i];
+                    writer.Key("name");writer.String(node.name.c_str(), node.name.size());
+                    writer.Key("type");writer.String(node.type.c_str(), node.type.size());
+                    writer.Key("value");writer.String(node.value.c_str(), node.value.size());
+                    writer.Key("status");writer.Uint(node.status);
+                    writer.Key("sourceTime");writer.Int64(node.sourceTime);
+                    writer.Key("serverTime");writer.Int64(node.serverTime);
+                    writer.Key("acquireTime");writer.Int64(node.acquireTime);
+                }
+                writer.Key("cached");writer.Bool(stream.nodes[i].has_value());
+                writer.EndObject();
+            }
+            stream.position += count;
+            written += count;
+            if (stream.position == target.codes.size())
+            {
+                writer.EndArray();
+                writer.EndObject();
+                stream.target++;
+                stream.position = 0;
+            }
+        }
+        const bool finished = stream.target == stream.targets.size();
+        if (finished)
+        {
+            writer.EndArray();
+            writer.EndObject();
+        }
+        if (!sink.write(stream.sb.GetString(), stream.sb.GetSize()))
+        {
+            return false;
+        }
+        stream.sb.Clear();
+        if (finished)
+        {
+            sink.done();
+        }
+        return true;
+    }
+
+    // 以chunked方式逐块输出，响应格式与generateResponseContent一致
+    void streamValues(std::shared_ptr<ValueStream> stream, httplib::Response& res)
+    {
+        res.set_chunked_content_provider("application/json", [stream](size_t, httplib::DataSink& sink)
+        {
+            try
+            {
+                return writeValueChunk(*stream, sink);
+            }
+            catch (std::exception& e)
+            {
+                // 响应头已发出，只能中断连接
+                LogErr("批量查询输出失败：{}", e.what());
+                return false;
+            }
+        });
+    }
+}
+
 
 OPCClient* OPCClient::mpInstance = nullptr;
 
@@ -30,20 +157,25 @@ OPCClient* OPCClient::getInstance()
 
 OPCClient::OPCClient() : QObject(nullptr)
 {
-    mpKafkaProducer = new KafkaProducer();
-    mpKafkaProducerThread = new QThread(this);
-    mpKafkaProducer->moveToThread(mpKafkaProducerThread);
-    mpKafkaProducerThread->start();
     mpHttpServer = new httplib::Server();
     initHttpServer();
 }
 
 OPCClient::~OPCClient()
 {
-    for (auto& client : mClients)
+    if (nullptr != mpIOEngine)
     {
-        client.second->stop();
+        mpIOEngine->stop();
     }
+    for (auto&& [code, client] : *clients())
+    {
+        if (nullptr != mpIOEngine)
+        {
+            mpIOEngine->detach(client);
+        }
+        client->stop();
+    }
+    delete mpIOEngine;
 }
 
 void OPCClient::loadConfig(const std::string& configFile)
@@ -68,6 +200,30 @@ void OPCClient::loadConfig(const std::string& configFile)
                 mpHttpServer->listen("localhost", port);
             });
         }
+        if (mKafkaProducers.empty())
+        {
+            createKafkaProducers(config["kafka_producer"]);
+            // 生产线程上的drainRing会读取这些配置，须在任何设备接入并开始采集前加载完毕
+            for (auto producer : mKafkaProducers)
+            {
+                producer->loadConfig(configFile);
+            }
+        }
+        if (nullptr == mpIOEngine)
+        {
+            int ioThreads = 2;
+            int ioTick = 5;
+            if (mConfig["io_threads"])
+            {
+                ioThreads = mConfig["io_threads"].as<int>();
+            }
+            if (mConfig["io_tick"])
+            {
+                ioTick = mConfig["io_tick"].as<int>();
+            }
+            mpIOEngine = new IOEngine(ioThreads, std::chrono::milliseconds(ioTick));
+            mpIOEngine->start();
+        }
         if (mConfig["clients"])
         {
             for (int i = 0; i < mConfig["clients"].size(); i++)
@@ -111,8 +267,85 @@ void OPCClient::loadConfig(const std::string& configFile)
                 client->setCode(code);
                 client->setTopic(topic);
                 client->setInterval(interval);
-                connect(client.get(), &Machine::newData, mpKafkaProducer, &KafkaProducer::onNewDatas);
-                client->start();
+                if (clientConfig["read_batch_size"])
+                {
+                    client->setReadBatchSize(clientConfig["read_batch_size"].as<int>());
+                }
+                if (clientConfig["reconnect_min"] || clientConfig["reconnect_max"])
+                {
+                    client->setReconnectBackoff(clientConfig["reconnect_min"] ? clientConfig["reconnect_min"].as<int>() : 1000,
+                                                clientConfig["reconnect_max"] ? clientConfig["reconnect_max"].as<int>() : 30000);
+                }
+                if (clientConfig["command_timeout"])
+                {
+                    client->setCommandTimeout(clientConfig["command_timeout"].as<int>());
+                }
+                if (clientConfig["align_to_wall_clock"])
+                {
+                    client->setAlignToWallClock(clientConfig["align_to_wall_clock"].as<bool>());
+                }
+                {
+                    // 地址空间浏览索引缓存，默认按客户端code命名
+                    auto browseCache = "./cache/" + QString::fromStdString(code).replace(':', '_').toStdString() + ".json";
+                    int browseRefresh = 3600;
+                    if (clientConfig["browse_cache"])
+                    {
+                        browseCache = clientConfig["browse_cache"].as<std::string>();
+                    }
+                    if (clientConfig["browse_refresh_interval"])
+                    {
+                        browseRefresh = clientConfig["browse_refresh_interval"].as<int>();
+                    }
+                    client->setBrowseCache(browseCache, browseRefresh);
+                }
+                if (clientConfig["report_by_exception"])
+                {
+                    int heartbeat = 0;
+                    if (clientConfig["heartbeat"])
+                    {
+                        heartbeat = clientConfig["heartbeat"].as<int>();
+                    }
+                    client->setReportByException(clientConfig["report_by_exception"].as<bool>(), heartbeat);
+                }
+                if (clientConfig["mode"] && "subscription" == clientConfig["mode"].as<std::string>())
+                {
+                    double publishingInterval = interval;
+                    double samplingInterval = interval;
+                    uint32_t queueSize = 1;
+                    if (clientConfig["publishing_interval"])
+                    {
+                        publishingInterval = clientConfig["publishing_interval"].as<double>();
+                    }
+                    if (clientConfig["sampling_interval"])
+                    {
+                        samplingInterval = clientConfig["sampling_interval"].as<double>();
+                    }
+                    if (clientConfig["queue_size"])
+                    {
+                        queueSize = clientConfig["queue_size"].as<uint32_t>();
+                    }
+                    client->setMode(AcquisitionMode::Subscription);
+                    client->setSubscriptionParameters(publishingInterval, samplingInterval, queueSize);
+                }
+                auto producer = kafkaProducer(code);
+                client->setSampleRing(producer->sampleRing());
+                // 只设置原子标志，直接在生产者线程中调用
+                connect(producer, &KafkaProducer::backpressureChanged, client.get(), &Machine::setBackpressure,
+                        Qt::DirectConnection);
+                if (clientConfig["backpressure_interval"])
+                {
+                    client->setBackpressureInterval(clientConfig["backpressure_interval"].as<int>());
+                }
+                if (clientConfig["history"] && clientConfig["history"]["enabled"] &&
+                    clientConfig["history"]["enabled"].as<bool>())
+                {
+                    size_t memoryBudget = 32 * 1024 * 1024;
+                    if (clientConfig["history"]["memory_budget"])
+                    {
+                        memoryBudget = clientConfig["history"]["memory_budget"].as<size_t>();
+                    }
+                    client->setHistoryBudget(memoryBudget);
+                }
 
                 if (clientConfig["nodes_config"])
                 {
@@ -124,11 +357,77 @@ void OPCClient::loadConfig(const std::string& configFile)
                         {
                             continue;
                         }
-                        std::string node_code;
-                        for (auto&& j : nodeConfig)
+                        // 节点可为"ns:id"字符串，或带死区配置的{code, deadband, deadband_value, range}
+                        auto collect = [&client](const YAML::Node& node, const std::string& group)
+                        {
+                            if (node.IsScalar())
+                            {
+                                client->collectNode(node.as<std::string>(), group);
+                                return;
+                            }
+                            if (!node["code"])
+                            {
+                                LogErr("节点配置中不存在code！");
+                                return;
+                            }
+                            auto code = node["code"].as<std::string>();
+                            client->collectNode(code, group);
+                            if (node["deadband"])
+                            {
+                                Deadband deadband;
+                                auto type = node["deadband"].as<std::string>();
+                                if ("absolute" == type)
+                                {
+                                    deadband.type = DeadbandType::Absolute;
+                                }
+                                else if ("percent" == type)
+                                {
+                                    deadband.type = DeadbandType::Percent;
+                                }
+                                if (node["deadband_value"])
+                                {
+                                    deadband.value = node["deadband_value"].as<double>();
+                                }
+                                if (node["range"] && node["range"].size() == 2)
+                                {
+                                    deadband.low = node["range"][0].as<double>();
+                                    deadband.high = node["range"][1].as<double>();
+                                }
+                                client->setDeadband(code, deadband);
+                            }
+                        };
+                        if (nodeConfig.IsSequence())
                         {
-                            node_code = j.as<std::string>();
-                            client->collectNode(node_code);
+                            for (auto&& j : nodeConfig)
+                            {
+                                collect(j, DefaultScanGroup);
+                            }
+                        }
+                        else if (nodeConfig["groups"])
+                        {
+                            for (auto&& groupConfig : nodeConfig["groups"])
+                            {
+                                if (!groupConfig["name"])
+                                {
+                                    LogErr("扫描组配置中不存在name！");
+                                    continue;
+                                }
+                                auto groupName = groupConfig["name"].as<std::string>();
+                                int groupInterval = interval;
+                                if (groupConfig["interval"])
+                                {
+                                    groupInterval = groupConfig["interval"].as<int>();
+                                    if (groupInterval < 1)
+                                    {
+                                        groupInterval = interval;
+                                    }
+                                }
+                                client->addScanGroup(groupName, groupInterval);
+                                for (auto&& j : groupConfig["nodes"])
+                                {
+                                    collect(j, groupName);
+                                }
+                            }
                         }
                     }
                     catch (YAML::Exception& e)
@@ -141,14 +440,16 @@ void OPCClient::loadConfig(const std::string& configFile)
                     LogWarn("OPCClient配置中不存在nodes节点!");
                 }
                 client->start();
-                mClients.emplace(code, client);
+                mpIOEngine->attach(client);
+                auto clientMap = std::make_shared<MachineMap>(*clients());
+                clientMap->emplace(code, client);
+                mpClients.store(std::move(clientMap));
             }
         }
         else
         {
             LogWarn("配置文件中不存在OPC客户端配置！");
         }
-        mpKafkaProducer->loadConfig(configFile);
     }
     catch (const YAML::Exception& e)
     {
@@ -156,6 +457,81 @@ void OPCClient::loadConfig(const std::string& configFile)
     }
 }
 
+void OPCClient::createKafkaProducers(const YAML::Node& kafkaNode)
+{
+    int shards = 1;
+    size_t ringCapacity = 1024;
+    auto overflowPolicy = OverflowPolicy::Coalesce;
+    if (kafkaNode)
+    {
+        if (kafkaNode["shards"])
+        {
+            shards = std::max(kafkaNode["shards"].as<int>(), 1);
+        }
+        if (kafkaNode["ring"])
+        {
+            auto ringNode = kafkaNode["ring"];
+            if (ringNode["capacity"])
+            {
+                ringCapacity = ringNode["capacity"].as<size_t>();
+            }
+            if (ringNode["overflow"])
+            {
+                auto overflow = ringNode["overflow"].as<std::string>();
+                if ("drop_oldest" == overflow)
+                {
+                    overflowPolicy = OverflowPolicy::DropOldest;
+                }
+                else if ("coalesce" != overflow)
+                {
+                    // 入队在I/O工作线程上，等待会阻塞同线程的全部设备，不再支持block
+                    LogWarn("不支持的队列溢出策略[{}]，使用coalesce", overflow);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < shards; i++)
+    {
+        auto producer = new KafkaProducer();
+        producer->setShard(i, shards);
+        producer->createSampleRing(ringCapacity, overflowPolicy);
+        auto thread = new QThread(this);
+        producer->moveToThread(thread);
+        thread->start();
+        mKafkaProducers.push_back(producer);
+        mKafkaProducerThreads.push_back(thread);
+    }
+    LogInfo("Kafka生产者分片数：{}", shards);
+}
+
+KafkaProducer* OPCClient::kafkaProducer(const std::string& code)
+{
+    return mKafkaProducers[std::hash<std::string>{}(code) % mKafkaProducers.size()];
+}
+
+std::shared_ptr<const OPCClient::MachineMap> OPCClient::clients() const
+{
+    auto clientMap = mpClients.load();
+    if (nullptr == clientMap)
+    {
+        static const auto empty = std::make_shared<const MachineMap>();
+        return empty;
+    }
+    return clientMap;
+}
+
+std::shared_ptr<Machine> OPCClient::findClient(const std::string& machine) const
+{
+    auto clientMap = clients();
+    auto iter = clientMap->find(machine);
+    if (iter == clientMap->end())
+    {
+        OPCClientNotExistException exception(fmt::format("OPC客户端[{}]不存在", machine));
+        exception.rethrow();
+    }
+    return iter->second;
+}
+
 void OPCClient::stopHttpServer()
 {
     if (mpHttpServer->is_running())
@@ -196,14 +572,7 @@ void OPCClient::initHttpServer()
             std::string machine = req.get_param_value("machine");
             std::string code = req.get_param_value("code");
             std::string value = req.get_param_value("value");
-            std::scoped_lock lock(mClientsMutex);
-            auto iter = mClients.find(machine);
-            if (iter == mClients.end())
-            {
-                OPCClientNotExistException exception(fmt::format("OPC客户端[{}]不存在", machine));
-                exception.rethrow();
-            }
-            auto client = iter->second;
+            auto client = findClient(machine);
             client->setNodeValue(code, value);
             auto result = generateResponseContent(
                 200, fmt::format("{{发送指令[machine:{}, code:{}, value:{}]成功}}", machine, code, value));
@@ -221,15 +590,13 @@ void OPCClient::initHttpServer()
         {
             std::string machine = req.get_param_value("machine");
             std::string code = req.get_param_value("code");
-            std::scoped_lock lock(mClientsMutex);
-            auto iter = mClients.find(machine);
-            if (iter == mClients.end())
+            std::string group = req.has_param("group") ? req.get_param_value("group") : DefaultScanGroup;
+            auto client = findClient(machine);
+            if (req.has_param("interval"))
             {
-                OPCClientNotExistException exception(fmt::format("OPC客户端[{}]不存在", machine));
-                exception.rethrow();
+                client->addScanGroup(group, std::stoi(req.get_param_value("interval")));
             }
-            auto client = iter->second;
-            client->collectNode(code);
+            client->collectNode(code, group);
             auto result =
                 generateResponseContent(200, fmt::format("{{添加OPC节点[machine:{}, code:{}]成功}}", machine, code));
             res.set_content(result, "application/json");
@@ -245,14 +612,7 @@ void OPCClient::initHttpServer()
         {
             std::string machine = req.get_param_value("machine");
             std::string code = req.get_param_value("code");
-            std::scoped_lock lock(mClientsMutex);
-            auto iter = mClients.find(machine);
-            if (iter == mClients.end())
-            {
-                OPCClientNotExistException exception(fmt::format("OPC客户端[{}]不存在", machine));
-                exception.rethrow();
-            }
-            auto client = iter->second;
+            auto client = findClient(machine);
             client->removeCollectingNode(code);
             auto result =
                 generateResponseContent(200, fmt::format("{{移除OPC节点[machine:{}, code:{}]成功}}", machine, code));
@@ -264,20 +624,30 @@ void OPCClient::initHttpServer()
         }
     });
 
+    mpHttpServer->Get("/refresh", [this](const httplib::Request& req, httplib::Response& res)
+    {
+        try
+        {
+            std::string machine = req.get_param_value("machine");
+            auto client = findClient(machine);
+            client->refreshNodeCache();
+            auto result =
+                generateResponseContent(200, fmt::format("{{刷新OPC节点缓存[machine:{}]成功}}", machine));
+            res.set_content(result, "application/json");
+        }
+        catch (...)
+        {
+            std::rethrow_exception(std::current_exception());
+        }
+    });
+
     mpHttpServer->Get("/search", [this](const httplib::Request& req, httplib::Response& res)
     {
         std::string machine = req.get_param_value("machine");
         std::string type = req.get_param_value("type");
         if ("nodes" == type)
         {
-            std::scoped_lock lock(mClientsMutex);
-            auto iter = mClients.find(machine);
-            if (iter == mClients.end())
-            {
-                OPCClientNotExistException exception(fmt::format("OPC客户端[{}]不存在", machine));
-                exception.rethrow();
-            }
-            auto client = iter->second;
+            auto client = findClient(machine);
             rapidjson::StringBuffer sb;
             rapidjson::Writer writer(sb);
             writer.StartArray();
@@ -293,40 +663,232 @@ void OPCClient::initHttpServer()
         else if ("node" == type)
         {
             std::string code = req.get_param_value("code");
-            std::scoped_lock lock(mClientsMutex);
-            auto iter = mClients.find(machine);
-            if (iter == mClients.end())
+            auto client = findClient(machine);
+            // 默认只读取最新值缓存，仅live=1时读取设备；未缓存的节点返回404，不访问设备
+            const bool live = "1" == req.get_param_value("live");
+            NodeValue node;
+            const bool cached = !live && client->lastValue(code, node);
+            if (live)
             {
-                OPCClientNotExistException exception(fmt::format("OPC客户端[{}]不存在", machine));
-                exception.rethrow();
+                client->getNode(code, node);
+            }
+            else if (!cached)
+            {
+                res.set_content(
+                    generateResponseContent(404, fmt::format("OPC客户端[{}]节点[{}]不在最新值缓存中，可使用live=1读取设备",
+                                                             machine, code)),
+                    "application/json");
+                return;
             }
-            auto client = iter->second;
-            std::string name;
-            std::string type;
-            std::string value;
-            client->getNode(code, name, type, value);
             rapidjson::StringBuffer sb;
             rapidjson::Writer writer(sb);
             writer.StartObject();
             writer.Key("code");writer.String(code.c_str());
-            writer.Key("name");writer.String(name.c_str());
-            writer.Key("type");writer.String(type.c_str());
-            writer.Key("value");writer.String(value.c_str());
+            writer.Key("name");writer.String(node.name.c_str());
+            writer.Key("type");writer.String(node.type.c_str());
+            writer.Key("value");writer.String(node.value.c_str());
+            // 时间戳为Unix纪元微秒，0表示服务器未提供
+            writer.Key("status");writer.Uint(node.status);
+            writer.Key("sourceTime");writer.Int64(node.sourceTime);
+            writer.Key("serverTime");writer.Int64(node.serverTime);
+            writer.Key("acquireTime");writer.Int64(node.acquireTime);
+            writer.Key("cached");writer.Bool(cached);
             writer.EndObject();
             res.set_content(
                 generateResponseContent(200, fmt::format("OPC客户端[{}]节点[{}]查询成功", machine, code), sb.GetString(),true),
                 "application/json");
         }
-        else if ("url" == type)
+        else if ("history" == type)
         {
-            std::scoped_lock lock(mClientsMutex);
-            auto iter = mClients.find(machine);
-            if (iter == mClients.end())
+            std::string code = req.get_param_value("code");
+            auto client = findClient(machine);
+            // 时间为Unix纪元毫秒，默认查询最近10分钟
+            int64_t to = req.has_param("to") ? std::stoll(req.get_param_value("to"))
+                                             : currentUnixMicroseconds() / 1000;
+            int64_t from = req.has_param("from") ? std::stoll(req.get_param_value("from")) : to - 10 * 60 * 1000;
+            std::vector<HistoryPoint> points;
+            client->history(code, from, to, points);
+            auto [memoryBytes, pointCount] = client->historyUsage();
+            rapidjson::StringBuffer sb;
+            rapidjson::Writer writer(sb);
+            writer.StartObject();
+            writer.Key("code");writer.String(code.c_str());
+            writer.Key("from");writer.Int64(from);
+            writer.Key("to");writer.Int64(to);
+            writer.Key("memoryBytes");writer.Uint64(memoryBytes);
+            writer.Key("pointCount");writer.Uint64(pointCount);
+            writer.Key("points");
+            writer.StartArray();
+            for (auto&& point : points)
             {
-                OPCClientNotExistException exception(fmt::format("OPC客户端[{}]不存在", machine));
-                exception.rethrow();
+                writer.StartObject();
+                writer.Key("time");writer.Int64(point.time);
+                writer.Key("value");writer.Double(point.value);
+                writer.EndObject();
             }
-            auto client = iter->second;
+            writer.EndArray();
+            writer.EndObject();
+            res.set_content(
+                generateResponseContent(200, fmt::format("OPC客户端[{}]节点[{}]历史数据查询成功", machine, code),
+                                        sb.GetString(), true),
+                "application/json");
+        }
+        else if ("browse" == type)
+        {
+            auto client = findClient(machine);
+            auto entries = client->browseEntries();
+            rapidjson::StringBuffer sb;
+            rapidjson::Writer writer(sb);
+            writer.StartArray();
+            for (auto&& entry : *entries)
+            {
+                writer.StartObject();
+                writer.Key("code");writer.String(entry.code.c_str(), entry.code.size());
+                writer.Key("path");writer.String(entry.path.c_str(), entry.path.size());
+                writer.Key("class");writer.Uint(entry.nodeClass);
+                writer.Key("type");writer.String(entry.dataType.c_str(), entry.dataType.size());
+                writer.EndObject();
+            }
+            writer.EndArray();
+            res.set_content(
+                generateResponseContent(200, fmt::format("OPC客户端[{}]地址空间查询成功", machine), sb.GetString(), true),
+                "application/json");
+        }
+        else if ("stats" == type)
+        {
+            auto client = findClient(machine);
+            auto statistics = client->scanStatistics();
+            rapidjson::StringBuffer sb;
+            rapidjson::Writer writer(sb);
+            writer.StartArray();
+            for (auto&& [group, item] : statistics)
+            {
+                auto& [period, stats] = item;
+                writer.StartObject();
+                writer.Key("group");writer.String(group.c_str());
+                writer.Key("interval");writer.Int(period);
+                writer.Key("cycles");writer.Uint64(stats.cycles);
+                writer.Key("overruns");writer.Uint64(stats.overruns);
+                writer.Key("lastJitterUs");writer.Int64(stats.lastJitter);
+                writer.Key("minJitterUs");writer.Int64(stats.minJitter);
+                writer.Key("maxJitterUs");writer.Int64(stats.maxJitter);
+                writer.Key("meanJitterUs");writer.Double(stats.meanJitter);
+                writer.Key("lastDurationUs");writer.Int64(stats.lastDuration);
+                writer.Key("minDurationUs");writer.Int64(stats.minDuration);
+                writer.Key("maxDurationUs");writer.Int64(stats.maxDuration);
+                writer.Key("meanDurationUs");writer.Double(stats.meanDuration);
+                writer.EndObject();
+            }
+            writer.EndArray();
+            res.set_content(
+                generateResponseContent(200, fmt::format("OPC客户端[{}]采集统计查询成功", machine), sb.GetString(), true),
+                "application/json");
+        }
+        else if ("commands" == type)
+        {
+            auto client = findClient(machine);
+            auto stats = client->commandStatistics();
+            rapidjson::StringBuffer sb;
+            rapidjson::Writer writer(sb);
+            writer.StartObject();
+            writer.Key("commands");writer.Uint64(stats.commands);
+            writer.Key("failures");writer.Uint64(stats.failures);
+            writer.Key("timeouts");writer.Uint64(stats.timeouts);
+            writer.Key("lastLatencyUs");writer.Int64(stats.lastLatency);
+            writer.Key("maxLatencyUs");writer.Int64(stats.maxLatency);
+            writer.Key("meanLatencyUs");writer.Double(stats.meanLatency);
+            writer.EndObject();
+            res.set_content(
+                generateResponseContent(200, fmt::format("OPC客户端[{}]指令统计查询成功", machine), sb.GetString(), true),
+                "application/json");
+        }
+        else if ("kafka" == type)
+        {
+            // 生产者统计与machine无关，各分片累加
+            std::map<std::string, TopicStatistics> statistics;
+            size_t pendingMessages = 0, pendingBytes = 0, spoolBytes = 0;
+            uint64_t evictedSegments = 0, bufferAllocations = 0;
+            RingStatistics ring;
+            for (auto producer : mKafkaProducers)
+            {
+                for (auto&& [topic, stats] : producer->statistics())
+                {
+                    auto& total = statistics[topic];
+                    total.produced += stats.produced;
+                    total.delivered += stats.delivered;
+                    total.retried += stats.retried;
+                    total.dropped += stats.dropped;
+                    total.spooled += stats.spooled;
+                }
+                auto [messages, bytes] = producer->queueUsage();
+                pendingMessages += messages;
+                pendingBytes += bytes;
+                auto [disk, evicted] = producer->spoolUsage();
+                spoolBytes += disk;
+                evictedSegments += evicted;
+                bufferAllocations += producer->bufferAllocations();
+                auto shardRing = producer->sampleRing()->statistics();
+                ring.capacity += shardRing.capacity;
+                ring.depth += shardRing.depth;
+                ring.highWaterMark = std::max(ring.highWaterMark, shardRing.highWaterMark);
+                ring.pushed += shardRing.pushed;
+                ring.dropped += shardRing.dropped;
+                ring.coalesced += shardRing.coalesced;
+            }
+            rapidjson::StringBuffer sb;
+            rapidjson::Writer writer(sb);
+            writer.StartObject();
+            writer.Key("shards");writer.Uint64(mKafkaProducers.size());
+            writer.Key("pendingMessages");writer.Uint64(pendingMessages);
+            writer.Key("pendingBytes");writer.Uint64(pendingBytes);
+            writer.Key("spoolBytes");writer.Uint64(spoolBytes);
+            writer.Key("evictedSegments");writer.Uint64(evictedSegments);
+            writer.Key("bufferAllocations");writer.Uint64(bufferAllocations);
+            // 采集端到发送端的环形队列，highWaterMark为各分片的最大值
+            writer.Key("ring");
+            writer.StartObject();
+            writer.Key("capacity");writer.Uint64(ring.capacity);
+            writer.Key("depth");writer.Uint64(ring.depth);
+            writer.Key("highWaterMark");writer.Uint64(ring.highWaterMark);
+            writer.Key("pushed");writer.Uint64(ring.pushed);
+            writer.Key("dropped");writer.Uint64(ring.dropped);
+            writer.Key("coalesced");writer.Uint64(ring.coalesced);
+            writer.EndObject();
+            writer.Key("topics");
+            writer.StartArray();
+            for (auto&& [topic, stats] : statistics)
+            {
+                writer.StartObject();
+                writer.Key("topic");writer.String(topic.c_str());
+                writer.Key("produced");writer.Uint64(stats.produced);
+                writer.Key("delivered");writer.Uint64(stats.delivered);
+                writer.Key("retried");writer.Uint64(stats.retried);
+                writer.Key("dropped");writer.Uint64(stats.dropped);
+                writer.Key("spooled");writer.Uint64(stats.spooled);
+                writer.EndObject();
+            }
+            writer.EndArray();
+            writer.EndObject();
+            res.set_content(generateResponseContent(200, "Kafka发送统计查询成功", sb.GetString(), true),
+                            "application/json");
+        }
+        else if ("state" == type)
+        {
+            auto client = findClient(machine);
+            // 连接状态为原子量，设备离线或正在重连时也不会阻塞
+            rapidjson::StringBuffer sb;
+            rapidjson::Writer writer(sb);
+            writer.StartObject();
+            writer.Key("state");writer.String(connectionStateName(client->connectionState()));
+            writer.Key("reconnectAttempts");writer.Uint(client->reconnectAttempts());
+            writer.EndObject();
+            res.set_content(
+                generateResponseContent(200, fmt::format("OPC客户端[{}]连接状态查询成功", machine), sb.GetString(), true),
+                "application/json");
+        }
+        else if ("url" == type)
+        {
+            auto client = findClient(machine);
             auto url = client->url();
             res.set_content(generateResponseContent(200, fmt::format("OPC客户端[{}]URL查询成功", machine), url),
                             "application/json");
@@ -338,6 +900,183 @@ void OPCClient::initHttpServer()
         }
     });
 
+    mpHttpServer->Post("/batch_update", [this](const httplib::Request& req, httplib::Response& res)
+    {
+        // 请求体为[{machine, code, value}]数组，同一machine的指令合并为一次Write请求
+        rapidjson::Document document;
+        document.Parse(req.body.c_str(), req.body.size());
+        if (document.HasParseError() || !document.IsArray())
+        {
+            HttpRuntimeError e("批量指令格式错误，应为[{machine, code, value}]数组");
+            e.rethrow();
+        }
+        struct Item {
+            std::string machine;
+            std::string code;
+            std::string value;
+            WriteResult result;
+        };
+        std::vector<Item> items;
+        std::map<std::string, std::vector<size_t>> machines;
+        for (auto&& element : document.GetArray())
+        {
+            if (!element.IsObject() || !element.HasMember("machine") || !element.HasMember("code") ||
+                !element.HasMember("value") || !element["machine"].IsString() || !element["code"].IsString())
+            {
+                HttpRuntimeError e("批量指令格式错误，每项须包含machine、code与value");
+                e.rethrow();
+            }
+            Item item;
+            item.machine = element["machine"].GetString();
+            item.code = element["code"].GetString();
+            if (element["value"].IsString())
+            {
+                item.value = element["value"].GetString();
+            }
+            else
+            {
+                rapidjson::StringBuffer valueBuffer;
+                rapidjson::Writer valueWriter(valueBuffer);
+                element["value"].Accept(valueWriter);
+                item.value = valueBuffer.GetString();
+            }
+            machines[item.machine].push_back(items.size());
+            items.push_back(std::move(item));
+        }
+        for (auto&& [machine, positions] : machines)
+        {
+            std::vector<std::pair<std::string, std::string>> writes;
+            writes.reserve(positions.size());
+            for (auto position : positions)
+            {
+                writes.emplace_back(items[position].code, items[position].value);
+            }
+            try
+            {
+                auto client = findClient(machine);
+                auto results = client->setNodeValues(writes);
+                for (size_t i = 0; i < positions.size() && i < results.size(); i++)
+                {
+                    items[positions[i]].result = std::move(results[i]);
+                }
+            }
+            catch (Exception& e)
+            {
+                for (auto position : positions)
+                {
+                    items[position].result = {UA_STATUSCODE_BADCOMMUNICATIONERROR, e.message()};
+                }
+            }
+            catch (std::exception& e)
+            {
+                for (auto position : positions)
+                {
+                    items[position].result = {UA_STATUSCODE_BADCOMMUNICATIONERROR, e.what()};
+                }
+            }
+        }
+        rapidjson::StringBuffer sb;
+        rapidjson::Writer writer(sb);
+        writer.StartArray();
+        size_t succeeded = 0;
+        for (auto&& item : items)
+        {
+            writer.StartObject();
+            writer.Key("machine");writer.String(item.machine.c_str(), item.machine.size());
+            writer.Key("code");writer.String(item.code.c_str(), item.code.size());
+            writer.Key("value");writer.String(item.value.c_str(), item.value.size());
+            writer.Key("status");writer.Uint(item.result.status);
+            writer.Key("message");writer.String(item.result.message.c_str(), item.result.message.size());
+            writer.EndObject();
+            if (UA_StatusCode_isGood(item.result.status))
+            {
+                succeeded++;
+            }
+        }
+        writer.EndArray();
+        res.set_content(generateResponseContent(200, fmt::format("批量发送指令完成，成功{}/{}", succeeded, items.size()),
+                                                sb.GetString(), true),
+                        "application/json");
+    });
+
+    mpHttpServer->Get("/values", [this](const httplib::Request& req, httplib::Response& res)
+    {
+        // 只读取最新值缓存；未指定machine时返回全部设备，codes为逗号分隔的节点列表，未指定时返回全部采集节点
+        std::vector<std::string> codes;
+        if (req.has_param("codes"))
+        {
+            auto text = req.get_param_value("codes");
+            size_t begin = 0;
+            while (begin <= text.size())
+            {
+                auto end = std::min(text.find(',', begin), text.size());
+                if (end > begin)
+                {
+                    codes.emplace_back(text, begin, end - begin);
+                }
+                begin = end + 1;
+            }
+        }
+        auto stream = std::make_shared<ValueStream>();
+        if (req.has_param("machine"))
+        {
+            auto machine = req.get_param_value("machine");
+            stream->targets.push_back(valueTarget(machine, findClient(machine), std::move(codes)));
+        }
+        else
+        {
+            std::map<std::string, std::shared_ptr<Machine>> machines;
+            for (auto&& [machine, client] : *clients())
+            {
+                machines.emplace(machine, client);
+            }
+            for (auto&& [machine, client] : machines)
+            {
+                stream->targets.push_back(valueTarget(machine, client, codes));
+            }
+        }
+        stream->message = fmt::format("查询最新值成功，共{}台设备", stream->targets.size());
+        streamValues(std::move(stream), res);
+    });
+
+    mpHttpServer->Post("/values", [this](const httplib::Request& req, httplib::Response& res)
+    {
+        // 请求体为[{machine, codes:[...]}]数组，codes省略时返回该设备全部采集节点
+        rapidjson::Document document;
+        document.Parse(req.body.c_str(), req.body.size());
+        if (document.HasParseError() || !document.IsArray())
+        {
+            HttpRuntimeError e("批量查询格式错误，应为[{machine, codes}]数组");
+            e.rethrow();
+        }
+        auto stream = std::make_shared<ValueStream>();
+        for (auto&& element : document.GetArray())
+        {
+            if (!element.IsObject() || !element.HasMember("machine") || !element["machine"].IsString() ||
+                (element.HasMember("codes") && !element["codes"].IsArray()))
+            {
+                HttpRuntimeError e("批量查询格式错误，每项须包含machine，codes须为数组");
+                e.rethrow();
+            }
+            std::string machine = element["machine"].GetString();
+            std::vector<std::string> codes;
+            if (element.HasMember("codes"))
+            {
+                codes.reserve(element["codes"].Size());
+                for (auto&& code : element["codes"].GetArray())
+                {
+                    if (code.IsString())
+                    {
+                        codes.emplace_back(code.GetString(), code.GetStringLength());
+                    }
+                }
+            }
+            stream->targets.push_back(valueTarget(machine, findClient(machine), std::move(codes)));
+        }
+        stream->message = fmt::format("查询最新值成功，共{}台设备", stream->targets.size());
+        streamValues(std::move(stream), res);
+    });
+
     mpHttpServer->set_exception_handler(
         [this](const httplib::Request& req, httplib::Response& res, const std::exception_ptr& ep)
         {
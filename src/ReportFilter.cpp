@@ -0,0 +1,127 @@
+//
+// Created by cumtzt on 25-3-24.
+//
+#include "ReportFilter.h"
+#include <cmath>
+
+void ReportFilter::setEnabled(bool enabled)
+{
+    mEnabled = enabled;
+}
+
+bool ReportFilter::enabled() const
+{
+    return mEnabled;
+}
+
+void ReportFilter::setHeartbeat(std::chrono::seconds heartbeat)
+{
+    std::scoped_lock lock(mDeadbandLocker);
+    mHeartbeat = heartbeat;
+}
+
+void ReportFilter::setDeadband(const std::string& code, const Deadband& deadband)
+{
+    std::scoped_lock lock(mDeadbandLocker);
+    mDeadbands[code] = deadband;
+    mDeadbandVersion++;
+}
+
+void ReportFilter::reset()
+{
+    mLastReports.clear();
+}
+
+void ReportFilter::filter(std::vector<Sample>& samples, const NodeDictionary& dictionary,
+                          const std::unordered_map<std::string, uint32_t>& indices, Clock::time_point now)
+{
+    if (!mEnabled)
+    {
+        return;
+    }
+    std::scoped_lock lock(mDeadbandLocker);
+    bool snapshot = mHeartbeat.count() > 0 && now >= mNextHeartbeat;
+    if (mLastReports.size() < dictionary.size())
+    {
+        mLastReports.resize(dictionary.size());
+    }
+    size_t kept = 0;
+    for (auto& sample : samples)
+    {
+        if (sample.index >= mLastReports.size())
+        {
+            continue;
+        }
+        auto& last = mLastReports[sample.index];
+        if (last.deadbandVersion != mDeadbandVersion)
+        {
+            auto iter = mDeadbands.find(dictionary[sample.index]);
+            last.deadband = iter != mDeadbands.end() ? iter->second : Deadband();
+            last.deadbandVersion = mDeadbandVersion;
+        }
+        last.latest = sample;
+        if (last.reported && !changed(last, sample))
+        {
+            continue;
+        }
+        last.sample = sample;
+        last.reported = true;
+        if (&samples[kept] != &sample)
+        {
+            samples[kept] = std::move(sample);
+        }
+        kept++;
+    }
+    samples.resize(kept);
+    if (snapshot)
+    {
+        // 心跳：输出当前节点集合中各节点最近一次采集的值，并以其作为新的死区基准，
+        // 订阅模式下同样得到完整快照；已移除节点的记录在此清除，不再以旧值上报
+        samples.clear();
+        for (size_t index = 0; index < mLastReports.size(); index++)
+        {
+            auto& last = mLastReports[index];
+            if (!last.reported)
+            {
+                continue;
+            }
+            if (index >= dictionary.size() || !indices.contains(dictionary[index]))
+            {
+                last = Report();
+                continue;
+            }
+            last.sample = last.latest;
+            samples.push_back(last.latest);
+        }
+        mNextHeartbeat = now + mHeartbeat;
+    }
+}
+
+bool ReportFilter::changed(const Report& last, const Sample& current)
+{
+    // 质量码变化(如Good转Bad)即视为变化，不受死区影响
+    if (last.sample.status != current.status)
+    {
+        return true;
+    }
+    double lastNumber = 0;
+    double currentNumber = 0;
+    if (!sampleToDouble(last.sample.value, lastNumber) || !sampleToDouble(current.value, currentNumber))
+    {
+        return last.sample.value != current.value;
+    }
+    double delta = std::fabs(currentNumber - lastNumber);
+    const auto& deadband = last.deadband;
+    switch (deadband.type)
+    {
+    case DeadbandType::Absolute:
+        return delta > deadband.value;
+    case DeadbandType::Percent:
+        {
+            double range = deadband.high != deadband.low ? std::fabs(deadband.high - deadband.low) : std::fabs(lastNumber);
+            return delta > range * deadband.value / 100.0;
+        }
+    default:
+        return last.sample.value != current.value;
+    }
+}
@@ -0,0 +1,82 @@
+//
+// Created by cumtzt on 25-3-26.
+//
+#include "Sample.h"
+#include <fmt/format.h>
+#include <iterator>
+#include <chrono>
+
+const char* sampleTypeName(const SampleValue& value)
+{
+    switch (value.index())
+    {
+    case 1: return "bool";
+    case 2: return "int32_t";
+    case 3: return "uint32_t";
+    case 4: return "int64_t";
+    case 5: return "uint64_t";
+    case 6: return "float";
+    case 7: return "double";
+    case 8: return "string";
+    case 9: return "int8_t";
+    case 10: return "uint8_t";
+    case 11: return "int16_t";
+    case 12: return "uint16_t";
+    default: return "";
+    }
+}
+
+std::string formatSampleValue(const SampleValue& value)
+{
+    std::string text;
+    appendSampleValue(text, value);
+    return text;
+}
+
+void appendSampleValue(std::string& out, const SampleValue& value)
+{
+    std::visit([&out](auto&& v)
+    {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            out.push_back(v ? '1' : '0');
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            out.append(v);
+        }
+        else if constexpr (!std::is_same_v<T, std::monostate>)
+        {
+            fmt::format_to(std::back_inserter(out), "{}", v);
+        }
+    }, value);
+}
+
+bool sampleToDouble(const SampleValue& value, double& number)
+{
+    return std::visit([&number](auto&& v) -> bool
+    {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
+        {
+            number = static_cast<double>(v);
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }, value);
+}
+
+int64_t currentUnixMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t sampleTimestamp(const Sample& sample)
+{
+    return 0 != sample.sourceTime ? sample.sourceTime : sample.acquireTime;
+}
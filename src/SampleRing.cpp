@@ -0,0 +1,251 @@
+//
+// Created by cumtzt on 25-4-12.
+//
+#include "SampleRing.h"
+#include <bit>
+#include <algorithm>
+
+SampleRing::SampleRing(size_t capacity, OverflowPolicy policy) : mPolicy(policy)
+{
+    capacity = std::bit_ceil(std::max<size_t>(capacity, 2));
+    mCells = std::make_unique<Cell[]>(capacity);
+    mMask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++)
+    {
+        mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+void SampleRing::setNotify(std::function<void()> notify)
+{
+    mNotify = std::move(notify);
+}
+
+void SampleRing::push(const std::string& topic, const std::string& code, SampleBatch&& batch)
+{
+    mPushed.fetch_add(1, std::memory_order_relaxed);
+    if (OverflowPolicy::Coalesce == mPolicy && mCoalescedCount.load(std::memory_order_acquire) > 0)
+    {
+        // 该设备已有合并中的批次时继续合并，避免新批次越过它先发送
+        std::scoped_lock lock(mCoalesceLocker);
+        auto iter = mCoalescedBatches.find(code);
+        if (iter != mCoalescedBatches.end())
+        {
+            merge(iter->second.batch, std::move(batch));
+            mCoalesced.fetch_add(1, std::memory_order_relaxed);
+            notify();
+            return;
+        }
+    }
+    if (tryPush(topic, code, batch))
+    {
+        notify();
+        return;
+    }
+    switch (mPolicy)
+    {
+    case OverflowPolicy::DropOldest:
+        {
+            BatchSlot oldest;
+            do
+            {
+                if (tryPop(oldest))
+                {
+                    mDropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            while (!tryPush(topic, code, batch));
+            break;
+        }
+    case OverflowPolicy::Coalesce:
+        {
+            std::scoped_lock lock(mCoalesceLocker);
+            auto [iter, inserted] = mCoalescedBatches.try_emplace(code);
+            if (inserted)
+            {
+                iter->second.topic = topic;
+                iter->second.batch = std::move(batch);
+                iter->second.ticket = mEnqueuePos.load(std::memory_order_acquire);
+                mCoalescedCount.fetch_add(1, std::memory_order_release);
+            }
+            else
+            {
+                merge(iter->second.batch, std::move(batch));
+            }
+            mCoalesced.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+    notify();
+}
+
+bool SampleRing::pop(BatchSlot& slot)
+{
+    if (tryPop(slot))
+    {
+        return true;
+    }
+    return mCoalescedCount.load(std::memory_order_acquire) > 0 && popCoalesced(slot);
+}
+
+void SampleRing::rearm()
+{
+    mNotified.store(false, std::memory_order_release);
+}
+
+bool SampleRing::empty()
+{
+    return mEnqueuePos.load(std::memory_order_acquire) == mDequeuePos.load(std::memory_order_acquire) &&
+        0 == mCoalescedCount.load(std::memory_order_acquire);
+}
+
+size_t SampleRing::capacity() const
+{
+    return mMask + 1;
+}
+
+RingStatistics SampleRing::statistics()
+{
+    RingStatistics statistics;
+    statistics.capacity = capacity();
+    auto dequeue = mDequeuePos.load(std::memory_order_acquire);
+    auto enqueue = mEnqueuePos.load(std::memory_order_acquire);
+    statistics.depth = enqueue > dequeue ? static_cast<size_t>(enqueue - dequeue) : 0;
+    statistics.highWaterMark = mHighWaterMark.load(std::memory_order_relaxed);
+    statistics.pushed = mPushed.load(std::memory_order_relaxed);
+    statistics.dropped = mDropped.load(std::memory_order_relaxed);
+    statistics.coalesced = mCoalesced.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+bool SampleRing::tryPush(const std::string& topic, const std::string& code, SampleBatch& batch)
+{
+    Cell* cell = nullptr;
+    auto position = mEnqueuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+        cell = &mCells[position & mMask];
+        auto sequence = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+        if (0 == diff)
+        {
+            if (mEnqueuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    // 槽位字符串保留容量，稳定运行后赋值不分配内存
+    cell->slot.topic.assign(topic);
+    cell->slot.code.assign(code);
+    cell->slot.batch = std::move(batch);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    // drop_oldest时其他采集线程可能已将出队位置推过本槽位
+    auto dequeue = mDequeuePos.load(std::memory_order_relaxed);
+    auto depth = position + 1 > dequeue ? static_cast<size_t>(position + 1 - dequeue) : 0;
+    auto highWaterMark = mHighWaterMark.load(std::memory_order_relaxed);
+    while (depth > highWaterMark &&
+        !mHighWaterMark.compare_exchange_weak(highWaterMark, depth, std::memory_order_relaxed))
+    {
+    }
+    return true;
+}
+
+bool SampleRing::tryPop(BatchSlot& slot)
+{
+    Cell* cell = nullptr;
+    auto position = mDequeuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+        cell = &mCells[position & mMask];
+        auto sequence = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(position + 1);
+        if (0 == diff)
+        {
+            if (mDequeuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = mDequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+    // 交换字符串使两边都保留容量
+    slot.topic.swap(cell->slot.topic);
+    slot.code.swap(cell->slot.code);
+    slot.batch = std::move(cell->slot.batch);
+    cell->slot.batch = {};
+    cell->sequence.store(position + mMask + 1, std::memory_order_release);
+    return true;
+}
+
+bool SampleRing::popCoalesced(BatchSlot& slot)
+{
+    std::scoped_lock lock(mCoalesceLocker);
+    auto dequeue = mDequeuePos.load(std::memory_order_acquire);
+    for (auto iter = mCoalescedBatches.begin(); iter != mCoalescedBatches.end(); ++iter)
+    {
+        if (iter->second.ticket > dequeue)
+        {
+            continue;
+        }
+        slot.topic = iter->second.topic;
+        slot.code = iter->first;
+        slot.batch = std::move(iter->second.batch);
+        mCoalescedBatches.erase(iter);
+        mCoalescedCount.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+    return false;
+}
+
+void SampleRing::merge(SampleBatch& target, SampleBatch&& source)
+{
+    // 字典只追加，较新批次的字典覆盖较旧批次的全部下标
+    if (nullptr != source.dictionary)
+    {
+        target.dictionary = std::move(source.dictionary);
+    }
+    target.collectTime = std::max(target.collectTime, source.collectTime);
+    std::unordered_map<uint32_t, size_t> positions;
+    positions.reserve(target.samples.size());
+    for (size_t i = 0; i < target.samples.size(); i++)
+    {
+        positions[target.samples[i].index] = i;
+    }
+    for (auto& sample : source.samples)
+    {
+        auto iter = positions.find(sample.index);
+        if (iter == positions.end())
+        {
+            positions[sample.index] = target.samples.size();
+            target.samples.push_back(std::move(sample));
+        }
+        else
+        {
+            target.samples[iter->second] = std::move(sample);
+        }
+    }
+}
+
+void SampleRing::notify()
+{
+    if (!mNotified.exchange(true, std::memory_order_acq_rel) && mNotify)
+    {
+        mNotify();
+    }
+}
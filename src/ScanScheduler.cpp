@@ -0,0 +1,117 @@
+//
+// Created by cumtzt on 25-3-18.
+//
+#include "ScanScheduler.h"
+#include <algorithm>
+
+ScanScheduler::ScanScheduler(std::chrono::milliseconds period, bool alignToWallClock) :
+    mPeriod(std::max(period, std::chrono::milliseconds(1))), mAlignToWallClock(alignToWallClock)
+{
+    reset();
+}
+
+void ScanScheduler::setPeriod(std::chrono::milliseconds period)
+{
+    mPeriod = std::max(period, std::chrono::milliseconds(1));
+}
+
+std::chrono::milliseconds ScanScheduler::period() const
+{
+    return mPeriod;
+}
+
+void ScanScheduler::setAlignToWallClock(bool align)
+{
+    mAlignToWallClock = align;
+}
+
+bool ScanScheduler::alignToWallClock() const
+{
+    return mAlignToWallClock;
+}
+
+void ScanScheduler::reset()
+{
+    auto now = Clock::now();
+    mDeadline = now;
+    if (mAlignToWallClock)
+    {
+        // 对齐到系统时间的整周期边界，如1000ms周期对齐到整秒
+        auto sinceEpoch = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch());
+        auto period = std::chrono::duration_cast<std::chrono::microseconds>(mPeriod);
+        auto remain = sinceEpoch % period;
+        if (remain.count() > 0)
+        {
+            mDeadline = now + (period - remain);
+        }
+    }
+    mBegin = mDeadline;
+    std::scoped_lock lock(mStatisticsLocker);
+    mStatistics = ScanStatistics();
+}
+
+ScanScheduler::Clock::time_point ScanScheduler::nextDeadline() const
+{
+    return mDeadline;
+}
+
+bool ScanScheduler::due(Clock::time_point now) const
+{
+    return now >= mDeadline;
+}
+
+void ScanScheduler::begin(Clock::time_point now)
+{
+    mBegin = now;
+    auto jitter = std::chrono::duration_cast<std::chrono::microseconds>(now - mDeadline).count();
+    std::scoped_lock lock(mStatisticsLocker);
+    auto& s = mStatistics;
+    s.lastJitter = jitter;
+    if (0 == s.cycles)
+    {
+        s.minJitter = jitter;
+        s.maxJitter = jitter;
+    }
+    else
+    {
+        s.minJitter = std::min(s.minJitter, jitter);
+        s.maxJitter = std::max(s.maxJitter, jitter);
+    }
+    s.meanJitter += (static_cast<double>(jitter) - s.meanJitter) / static_cast<double>(s.cycles + 1);
+}
+
+void ScanScheduler::end(Clock::time_point now)
+{
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(now - mBegin).count();
+    // 跳过执行期间已经错过的触发点，按个数计入超时，而不是顺延周期
+    mDeadline += mPeriod;
+    uint64_t missed = 0;
+    if (now >= mDeadline)
+    {
+        missed = (now - mDeadline) / mPeriod + 1;
+        mDeadline += mPeriod * missed;
+    }
+    std::scoped_lock lock(mStatisticsLocker);
+    auto& s = mStatistics;
+    s.overruns += missed;
+    s.lastDuration = duration;
+    if (0 == s.cycles)
+    {
+        s.minDuration = duration;
+        s.maxDuration = duration;
+    }
+    else
+    {
+        s.minDuration = std::min(s.minDuration, duration);
+        s.maxDuration = std::max(s.maxDuration, duration);
+    }
+    s.meanDuration += (static_cast<double>(duration) - s.meanDuration) / static_cast<double>(s.cycles + 1);
+    s.cycles++;
+}
+
+ScanStatistics ScanScheduler::statistics() const
+{
+    std::scoped_lock lock(mStatisticsLocker);
+    return mStatistics;
+}
@@ -0,0 +1,412 @@
+//
+// Created by cumtzt on 25-4-8.
+//
+#include "Spool.h"
+#include "Logger.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QTextStream>
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+    constexpr std::array<uint32_t, 256> makeCrcTable()
+    {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }
+
+    constexpr auto CrcTable = makeCrcTable();
+
+    // 每确认多少条记录保存一次确认位置，重启后最多重复发送这么多条
+    constexpr uint32_t CursorSaveInterval = 100;
+}
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = CrcTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+Spool::~Spool()
+{
+    std::scoped_lock lock(mLocker);
+    if (!mOpened)
+    {
+        return;
+    }
+    closeReader();
+    closeWriter();
+    saveCursor();
+}
+
+bool Spool::open(const std::string& dir, size_t segmentBytes, size_t maxBytes)
+{
+    std::scoped_lock lock(mLocker);
+    mDir = dir;
+    mSegmentBytes = std::max<size_t>(segmentBytes, 64 * 1024);
+    mMaxBytes = std::max(maxBytes, mSegmentBytes);
+    if (!QDir().mkpath(QString::fromStdString(mDir)))
+    {
+        LogErr("创建落盘队列目录[{}]失败", mDir);
+        return false;
+    }
+    auto files = QDir(QString::fromStdString(mDir)).entryInfoList({"*.seg"}, QDir::Files, QDir::Name);
+    for (auto&& file : files)
+    {
+        bool ok = false;
+        auto sequence = file.completeBaseName().toULongLong(&ok);
+        if (!ok)
+        {
+            continue;
+        }
+        mSegments.push_back(sequence);
+        mDiskBytes += static_cast<size_t>(file.size());
+        mNextSequence = std::max<uint64_t>(mNextSequence, sequence + 1);
+    }
+    // 恢复读取位置，之前已读完但未及删除的段直接删除
+    QFile cursor(QString::fromStdString(mDir + "/cursor"));
+    if (cursor.open(QIODevice::ReadOnly))
+    {
+        QTextStream stream(&cursor);
+        quint64 sequence = 0;
+        qint64 offset = 0;
+        stream >> sequence >> offset;
+        while (!mSegments.empty() && mSegments.front() < sequence)
+        {
+            removeFront();
+        }
+        if (!mSegments.empty() && mSegments.front() == sequence)
+        {
+            mReadOffset = offset;
+        }
+    }
+    mNextOffset = mReadOffset;
+    mOpened = true;
+    LogInfo("落盘队列[{}]已打开，段数：{}，占用：{}字节", mDir, mSegments.size(), mDiskBytes);
+    return true;
+}
+
+bool Spool::isOpen()
+{
+    std::scoped_lock lock(mLocker);
+    return mOpened;
+}
+
+bool Spool::append(const std::string& topic, const std::string& key, const std::string& payload)
+{
+    std::scoped_lock lock(mLocker);
+    if (!mOpened || topic.size() > UINT16_MAX || key.size() > UINT16_MAX)
+    {
+        return false;
+    }
+    const auto bodySize = topic.size() + key.size() + payload.size();
+    const auto recordSize = static_cast<qint64>(sizeof(RecordHeader) + bodySize);
+    if (nullptr == mpWriteFile || mWriteOffset + recordSize > mWriteSize)
+    {
+        closeWriter();
+        if (!openWriter(std::max(mSegmentBytes, static_cast<size_t>(recordSize))))
+        {
+            return false;
+        }
+    }
+    // 先写记录体再写记录头，写入中途崩溃时残缺记录不会被当作有效记录
+    auto record = mpWriteData + mWriteOffset;
+    auto body = record + sizeof(RecordHeader);
+    std::memcpy(body, topic.data(), topic.size());
+    std::memcpy(body + topic.size(), key.data(), key.size());
+    std::memcpy(body + topic.size() + key.size(), payload.data(), payload.size());
+    RecordHeader header{};
+    header.crc = crc32(body, bodySize);
+    header.topicSize = static_cast<uint16_t>(topic.size());
+    header.keySize = static_cast<uint16_t>(key.size());
+    header.payloadSize = static_cast<uint32_t>(payload.size());
+    header.magic = RecordMagic;
+    std::memcpy(record, &header, sizeof(header));
+    mWriteOffset += recordSize;
+    evict();
+    return true;
+}
+
+bool Spool::peek(std::string& topic, std::string& key, std::string& payload)
+{
+    std::scoped_lock lock(mLocker);
+    while (mOpened && !mSegments.empty())
+    {
+        if (!openReader())
+        {
+            removeFront();
+            continue;
+        }
+        const bool active = nullptr != mpWriteFile && mSegments.front() == mWriteSequence;
+        const qint64 limit = active ? mWriteOffset : mReadSize;
+        if (mNextOffset + static_cast<qint64>(sizeof(RecordHeader)) > limit)
+        {
+            // 段内记录全部确认后才删除该段
+            if (active || !mOutstanding.empty())
+            {
+                return false;
+            }
+            removeFront();
+            continue;
+        }
+        RecordHeader header{};
+        std::memcpy(&header, mpReadData + mNextOffset, sizeof(header));
+        const qint64 bodySize = static_cast<qint64>(header.topicSize) + header.keySize + header.payloadSize;
+        const qint64 size = static_cast<qint64>(sizeof(header)) + bodySize;
+        if (RecordMagic != header.magic || mNextOffset + size > limit)
+        {
+            // 预分配的段以全零结尾；其他内容说明段已损坏，跳过剩余部分
+            if (0 != header.magic)
+            {
+                LogErr("落盘队列段[{}]在偏移{}处损坏，跳过剩余记录", mSegments.front(), mNextOffset);
+            }
+            if (active || !mOutstanding.empty())
+            {
+                return false;
+            }
+            removeFront();
+            continue;
+        }
+        auto body = mpReadData + mNextOffset + sizeof(header);
+        if (crc32(body, bodySize) != header.crc)
+        {
+            LogErr("落盘队列段[{}]偏移{}处记录CRC校验失败，已跳过", mSegments.front(), mNextOffset);
+            // 跳过的记录随前一条未确认记录一起确认
+            mNextOffset += size;
+            if (mOutstanding.empty())
+            {
+                mReadOffset = mNextOffset;
+            }
+            else
+            {
+                mOutstanding.back().second += size;
+            }
+            continue;
+        }
+        topic.assign(reinterpret_cast<const char*>(body), header.topicSize);
+        key.assign(reinterpret_cast<const char*>(body) + header.topicSize, header.keySize);
+        payload.assign(reinterpret_cast<const char*>(body) + header.topicSize + header.keySize, header.payloadSize);
+        mPeekSize = size;
+        return true;
+    }
+    return false;
+}
+
+uint64_t Spool::advance()
+{
+    std::scoped_lock lock(mLocker);
+    if (0 == mPeekSize)
+    {
+        return 0;
+    }
+    auto id = mNextRecordId++;
+    mOutstanding.emplace_back(id, mPeekSize);
+    mNextOffset += mPeekSize;
+    mPeekSize = 0;
+    return id;
+}
+
+void Spool::commit(uint64_t id)
+{
+    std::scoped_lock lock(mLocker);
+    if (mOutstanding.empty() || mOutstanding.front().first != id)
+    {
+        return;
+    }
+    mReadOffset += mOutstanding.front().second;
+    mOutstanding.pop_front();
+    if (++mCommitsSinceCursor >= CursorSaveInterval)
+    {
+        saveCursor();
+    }
+}
+
+void Spool::rewind()
+{
+    std::scoped_lock lock(mLocker);
+    mOutstanding.clear();
+    mNextOffset = mReadOffset;
+    mPeekSize = 0;
+}
+
+bool Spool::empty()
+{
+    std::scoped_lock lock(mLocker);
+    if (mSegments.empty())
+    {
+        return true;
+    }
+    return 1 == mSegments.size() && nullptr != mpWriteFile && mSegments.front() == mWriteSequence &&
+        mReadOffset >= mWriteOffset;
+}
+
+size_t Spool::diskBytes()
+{
+    std::scoped_lock lock(mLocker);
+    return mDiskBytes;
+}
+
+uint64_t Spool::evictedSegments()
+{
+    std::scoped_lock lock(mLocker);
+    return mEvictedSegments;
+}
+
+std::string Spool::segmentPath(uint64_t sequence) const
+{
+    return mDir + "/" + QString("%1.seg").arg(sequence, 20, 10, QChar('0')).toStdString();
+}
+
+bool Spool::openWriter(size_t size)
+{
+    auto sequence = mNextSequence++;
+    auto path = segmentPath(sequence);
+    auto file = std::make_unique<QFile>(QString::fromStdString(path));
+    if (!file->open(QIODevice::ReadWrite) || !file->resize(static_cast<qint64>(size)))
+    {
+        LogErr("创建落盘队列段[{}]失败：{}", path, file->errorString().toStdString());
+        return false;
+    }
+    auto data = file->map(0, static_cast<qint64>(size));
+    if (nullptr == data)
+    {
+        LogErr("映射落盘队列段[{}]失败：{}", path, file->errorString().toStdString());
+        file->close();
+        QFile::remove(QString::fromStdString(path));
+        return false;
+    }
+    mpWriteFile = std::move(file);
+    mpWriteData = data;
+    mWriteSequence = sequence;
+    mWriteSize = static_cast<qint64>(size);
+    mWriteOffset = 0;
+    mSegments.push_back(sequence);
+    mDiskBytes += size;
+    return true;
+}
+
+void Spool::closeWriter()
+{
+    if (nullptr == mpWriteFile)
+    {
+        return;
+    }
+    if (mpReadData == mpWriteData)
+    {
+        // 读取方重新映射截断后的文件，读取位置不变
+        mpReadData = nullptr;
+    }
+    mpWriteFile->unmap(mpWriteData);
+    mpWriteFile->resize(mWriteOffset);
+    mpWriteFile->close();
+    mDiskBytes -= static_cast<size_t>(mWriteSize - mWriteOffset);
+    mpWriteFile = nullptr;
+    mpWriteData = nullptr;
+    mWriteSequence = 0;
+    mWriteSize = 0;
+    mWriteOffset = 0;
+}
+
+bool Spool::openReader()
+{
+    if (nullptr != mpReadData)
+    {
+        return true;
+    }
+    auto sequence = mSegments.front();
+    if (nullptr != mpWriteFile && sequence == mWriteSequence)
+    {
+        mpReadData = mpWriteData;
+        return true;
+    }
+    auto file = std::make_unique<QFile>(QString::fromStdString(segmentPath(sequence)));
+    if (!file->open(QIODevice::ReadOnly) || file->size() <= 0)
+    {
+        return false;
+    }
+    auto size = file->size();
+    auto data = file->map(0, size);
+    if (nullptr == data)
+    {
+        LogErr("映射落盘队列段[{}]失败：{}", sequence, file->errorString().toStdString());
+        return false;
+    }
+    mpReadFile = std::move(file);
+    mpReadData = data;
+    mReadSize = size;
+    return true;
+}
+
+void Spool::closeReader()
+{
+    if (nullptr != mpReadFile)
+    {
+        mpReadFile->unmap(const_cast<uchar*>(mpReadData));
+        mpReadFile->close();
+        mpReadFile = nullptr;
+    }
+    mpReadData = nullptr;
+    mReadSize = 0;
+}
+
+void Spool::removeFront()
+{
+    closeReader();
+    auto sequence = mSegments.front();
+    if (nullptr != mpWriteFile && sequence == mWriteSequence)
+    {
+        closeWriter();
+    }
+    auto path = QString::fromStdString(segmentPath(sequence));
+    auto size = static_cast<size_t>(QFileInfo(path).size());
+    QFile::remove(path);
+    mDiskBytes -= std::min(size, mDiskBytes);
+    mSegments.pop_front();
+    mReadOffset = 0;
+    mNextOffset = 0;
+    mPeekSize = 0;
+    // 被淘汰段中未确认的记录随段一起丢弃，之后到达的确认按序号忽略
+    mOutstanding.clear();
+    saveCursor();
+}
+
+void Spool::evict()
+{
+    // 写入段始终保留
+    while (mDiskBytes > mMaxBytes && mSegments.size() > 1)
+    {
+        LogWarn("落盘队列[{}]超出{}字节上限，淘汰最旧段[{}]", mDir, mMaxBytes, mSegments.front());
+        removeFront();
+        mEvictedSegments++;
+    }
+}
+
+void Spool::saveCursor()
+{
+    mCommitsSinceCursor = 0;
+    QFile cursor(QString::fromStdString(mDir + "/cursor"));
+    if (!cursor.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        LogErr("保存落盘队列[{}]读取位置失败", mDir);
+        return;
+    }
+    QTextStream stream(&cursor);
+    stream << (mSegments.empty() ? 0 : mSegments.front()) << " " << mReadOffset;
+}
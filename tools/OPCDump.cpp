@@ -0,0 +1,113 @@
+//
+// Created by cumtzt on 25-4-10.
+//
+// 二进制消息查看工具：按字典将记录还原为节点Code与值
+//   OPCDump [-d 字典文件]... <消息文件|->
+// 字典文件为字典topic中的JSON消息，消息文件为一条Kafka消息的原始内容，"-"表示标准输入
+#include "BinaryCodec.h"
+#include <fmt/format.h>
+#include <fmt/chrono.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+#include <chrono>
+
+namespace
+{
+    bool readFile(const std::string& path, std::string& content)
+    {
+        if ("-" == path)
+        {
+            content.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+            return true;
+        }
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    std::string formatTime(int64_t microseconds)
+    {
+        auto time = std::chrono::system_clock::time_point(std::chrono::microseconds(microseconds));
+        return fmt::format("{:%Y-%m-%d %H:%M:%S}.{:06d}", std::chrono::floor<std::chrono::seconds>(time),
+                           static_cast<int>(microseconds % 1000000));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::unordered_map<uint32_t, BinaryDictionary> dictionaries;
+    std::string messageFile;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if ("-d" == arg && i + 1 < argc)
+        {
+            std::string content;
+            BinaryDictionary dictionary;
+            if (!readFile(argv[++i], content) || !decodeBinaryDictionary(content, dictionary))
+            {
+                std::cerr << "字典文件无效: " << argv[i] << std::endl;
+                return 1;
+            }
+            dictionaries[dictionary.id] = std::move(dictionary);
+        }
+        else
+        {
+            messageFile = arg;
+        }
+    }
+    if (messageFile.empty())
+    {
+        std::cerr << "用法: " << argv[0] << " [-d 字典文件]... <消息文件|->" << std::endl;
+        return 1;
+    }
+    std::string content;
+    if (!readFile(messageFile, content))
+    {
+        std::cerr << "读取消息文件失败: " << messageFile << std::endl;
+        return 1;
+    }
+    std::vector<BinaryRecord> records;
+    std::string error;
+    if (!decodeBinaryRecords(content.data(), content.size(), records, error))
+    {
+        std::cerr << "解码失败: " << error << std::endl;
+        return 1;
+    }
+    for (const auto& record : records)
+    {
+        auto iter = dictionaries.find(record.dictionaryId);
+        const BinaryDictionary* dictionary = iter == dictionaries.end() ? nullptr : &iter->second;
+        std::cout << fmt::format("dictionary={} source={} collectTime={} samples={}", record.dictionaryId,
+                                 dictionary ? dictionary->source : "?", formatTime(record.collectTime),
+                                 record.samples.size()) << std::endl;
+        if (nullptr != dictionary && dictionary->nodes.size() < record.dictionarySize)
+        {
+            std::cout << fmt::format("  字典版本过旧：需要{}项，当前{}项", record.dictionarySize,
+                                     dictionary->nodes.size()) << std::endl;
+        }
+        for (const auto& sample : record.samples)
+        {
+            auto code = nullptr != dictionary && sample.index < dictionary->nodes.size()
+                            ? dictionary->nodes[sample.index]
+                            : fmt::format("#{}", sample.index);
+            std::cout << fmt::format("  {} {} {}", code, sampleTypeName(sample.value), formatSampleValue(sample.value));
+            if (0 != sample.status)
+            {
+                std::cout << fmt::format(" status=0x{:08X}", sample.status);
+            }
+            if (0 != sample.sourceTime)
+            {
+                std::cout << " sourceTime=" << formatTime(sample.sourceTime);
+            }
+            std::cout << std::endl;
+        }
+    }
+    return 0;
+}